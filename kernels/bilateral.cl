@@ -0,0 +1,163 @@
+// Bilateral filter: each tap is weighted by its distance from the centre (spatial)
+// and by how far its colour is from the centre's (range), so edges are kept while
+// flat areas are smoothed. Built with -D options:
+//   RADIUS     window radius
+//   SPATIAL    spatial weights, the (2 * RADIUS + 1)^2 matrix, or its 2 * RADIUS + 1
+//              row factor when SEPARABLE is defined
+//   SEPARABLE  a row pass and a column pass instead of the full window
+//   TILE_SIZE  work-group side of the tiled kernel
+// The range weights come from a table indexed by the rounded RGB distance, in place
+// of an exp() per tap.
+#ifndef TILE_SIZE
+#define TILE_SIZE 16
+#endif
+#define SIZE (2 * RADIUS + 1)
+#define TILE_SPAN (TILE_SIZE + 2 * RADIUS)
+// Largest RGB distance, sqrt(3) * 255, rounded up, plus one
+#define RANGE_SIZE 443
+
+__constant float spatial[] = {SPATIAL};
+
+inline float rangeWeight(__constant const float* range, float3 a, float3 b) {
+    return range[min(convert_int_rte(fast_length(a - b)), RANGE_SIZE - 1)];
+}
+
+inline uchar4 store(float3 sum, float norm) {
+    return (uchar4)(convert_uchar3_sat_rte(sum / norm), 255);
+}
+
+#ifndef SEPARABLE
+// Each work-group loads its tile plus a halo of RADIUS pixels, clamped to the image
+// edges, as in gaussian_blur
+__kernel __attribute__((reqd_work_group_size(TILE_SIZE, TILE_SIZE, 1)))
+void bilateral(__global const uchar4* input,
+               __global uchar4* output,
+               const int width,
+               const int height,
+               __constant const float* range) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    const int lx = get_local_id(0);
+    const int ly = get_local_id(1);
+    const int originX = get_group_id(0) * TILE_SIZE - RADIUS;
+    const int originY = get_group_id(1) * TILE_SIZE - RADIUS;
+
+    __local uchar4 tile[TILE_SPAN][TILE_SPAN];
+
+    for (int ty = ly; ty < TILE_SPAN; ty += TILE_SIZE) {
+        int iy = clamp(originY + ty, 0, height - 1);
+
+        for (int tx = lx; tx < TILE_SPAN; tx += TILE_SIZE) {
+            int ix = clamp(originX + tx, 0, width - 1);
+            tile[ty][tx] = input[iy * width + ix];
+        }
+    }
+
+    // Every work-item has to reach the barrier, so out of range ones leave after it
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (x >= width || y >= height)
+        return;
+
+    const float3 center = convert_float3(tile[ly + RADIUS][lx + RADIUS].xyz);
+    float3 sum = (float3)(0.0f);
+    float norm = 0.0f;
+    for (int ky = 0; ky < SIZE; ky++) {
+        for (int kx = 0; kx < SIZE; kx++) {
+            const float3 rgb = convert_float3(tile[ly + ky][lx + kx].xyz);
+            const float weight = spatial[ky * SIZE + kx] * rangeWeight(range, rgb, center);
+            sum += rgb * weight;
+            norm += weight;
+        }
+    }
+
+    output[y * width + x] = store(sum, norm);
+}
+
+// Several images packed back to back, described by images as in gaussian_blur_batched;
+// taps are read directly and clamped to the edges of their own image
+__kernel void bilateral_batched(__global const uchar4* input,
+                                __global uchar4* output,
+                                __global const int4* images,
+                                __constant const float* range) {
+    const int4 image = images[get_global_id(2)];
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    const int width = image.y;
+    const int height = image.z;
+
+    if (x >= width || y >= height)
+        return;
+
+    __global const uchar4* src = input + image.x;
+
+    const float3 center = convert_float3(src[y * width + x].xyz);
+    float3 sum = (float3)(0.0f);
+    float norm = 0.0f;
+    for (int ky = 0; ky < SIZE; ky++) {
+        int iy = clamp(y + ky - RADIUS, 0, height - 1);
+
+        for (int kx = 0; kx < SIZE; kx++) {
+            const float3 rgb = convert_float3(src[iy * width + clamp(x + kx - RADIUS, 0, width - 1)].xyz);
+            const float weight = spatial[ky * SIZE + kx] * rangeWeight(range, rgb, center);
+            sum += rgb * weight;
+            norm += weight;
+        }
+    }
+
+    output[image.x + y * width + x] = store(sum, norm);
+}
+#else
+// Separable approximation for large radii: a horizontal bilateral pass into float4,
+// then a vertical one comparing against the filtered rows. 2 * SIZE taps per pixel
+// instead of SIZE^2, at the cost of some streaking along diagonal edges.
+__kernel void bilateral_rows(__global const uchar4* input,
+                             __global float4* output,
+                             const int width,
+                             const int height,
+                             __constant const float* range) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= width || y >= height)
+        return;
+
+    __global const uchar4* row = input + y * width;
+
+    const float3 center = convert_float3(row[x].xyz);
+    float3 sum = (float3)(0.0f);
+    float norm = 0.0f;
+    for (int k = 0; k < SIZE; k++) {
+        const float3 rgb = convert_float3(row[clamp(x + k - RADIUS, 0, width - 1)].xyz);
+        const float weight = spatial[k] * rangeWeight(range, rgb, center);
+        sum += rgb * weight;
+        norm += weight;
+    }
+
+    output[y * width + x] = (float4)(sum / norm, 255.0f);
+}
+
+__kernel void bilateral_columns(__global const float4* input,
+                                __global uchar4* output,
+                                const int width,
+                                const int height,
+                                __constant const float* range) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= width || y >= height)
+        return;
+
+    const float3 center = input[y * width + x].xyz;
+    float3 sum = (float3)(0.0f);
+    float norm = 0.0f;
+    for (int k = 0; k < SIZE; k++) {
+        const float3 rgb = input[clamp(y + k - RADIUS, 0, height - 1) * width + x].xyz;
+        const float weight = spatial[k] * rangeWeight(range, rgb, center);
+        sum += rgb * weight;
+        norm += weight;
+    }
+
+    output[y * width + x] = store(sum, norm);
+}
+#endif
@@ -0,0 +1,119 @@
+// Box blur as running sums, one work-item per row or column, for the successive boxes
+// of the approximate Gaussian; a single box reads the summed-area table instead (see
+// box_blur_table in integral.cl). Each step adds the pixel entering the window and drops
+// the one leaving it, so the cost per pixel is the same at any radius. Edges are clamped
+// like the other neighbourhood filters.
+// Passes chain through float4 intermediates, so successive boxes (the approximate
+// Gaussian) round only once, on the final store.
+
+inline uchar4 store(float4 sum) {
+    uchar4 rgba = convert_uchar4_sat_rte(sum);
+    rgba.w = 255;
+    return rgba;
+}
+
+// Slides a window of 2 * radius + 1 over n elements; LOAD(i) reads element i and
+// STORE(i, v) writes the average of the window centred on it
+#define SLIDE(n, LOAD, STORE)                                                \
+    const float scale = 1.0f / (2 * radius + 1);                             \
+    float4 sum = LOAD(0) * (float)(radius + 1);                              \
+    for (int i = 1; i <= radius; i++)                                        \
+        sum += LOAD(min(i, (n) - 1));                                        \
+    for (int i = 0; i < (n); i++) {                                          \
+        STORE(i, sum * scale);                                               \
+        sum += LOAD(min(i + radius + 1, (n) - 1)) - LOAD(max(i - radius, 0)); \
+    }
+
+#define ROW_UCHAR(i) convert_float4(input[y * width + (i)])
+#define ROW_FLOAT(i) input[y * width + (i)]
+#define COLUMN_FLOAT(i) input[(i) * width + x]
+#define STORE_ROW(i, v) output[y * width + (i)] = (v)
+#define STORE_COLUMN(i, v) output[(i) * width + x] = (v)
+#define STORE_COLUMN_UCHAR(i, v) output[(i) * width + x] = store(v)
+
+// First horizontal pass, from pixels
+__kernel void box_rows(__global const uchar4* input,
+                       __global float4* output,
+                       const int width,
+                       const int height,
+                       const int radius) {
+    const int y = get_global_id(0);
+
+    if (y >= height)
+        return;
+
+    SLIDE(width, ROW_UCHAR, STORE_ROW)
+}
+
+// Further horizontal passes
+__kernel void box_rows_float(__global const float4* input,
+                             __global float4* output,
+                             const int width,
+                             const int height,
+                             const int radius) {
+    const int y = get_global_id(0);
+
+    if (y >= height)
+        return;
+
+    SLIDE(width, ROW_FLOAT, STORE_ROW)
+}
+
+// Vertical passes but the last; neighbouring work-items touch neighbouring columns,
+// so every step reads and writes one contiguous row segment per work-group
+__kernel void box_columns_float(__global const float4* input,
+                                __global float4* output,
+                                const int width,
+                                const int height,
+                                const int radius) {
+    const int x = get_global_id(0);
+
+    if (x >= width)
+        return;
+
+    SLIDE(height, COLUMN_FLOAT, STORE_COLUMN)
+}
+
+// Last vertical pass, back to pixels
+__kernel void box_columns(__global const float4* input,
+                          __global uchar4* output,
+                          const int width,
+                          const int height,
+                          const int radius) {
+    const int x = get_global_id(0);
+
+    if (x >= width)
+        return;
+
+    SLIDE(height, COLUMN_FLOAT, STORE_COLUMN_UCHAR)
+}
+
+// Several images packed back to back, described by images as in gaussian_blur_batched.
+// Batched images are small, so the window is summed directly.
+__kernel void box_blur_batched(__global const uchar4* input,
+                               __global uchar4* output,
+                               __global const int4* images,
+                               const int radius) {
+    const int4 image = images[get_global_id(2)];
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    const int width = image.y;
+    const int height = image.z;
+
+    if (x >= width || y >= height)
+        return;
+
+    __global const uchar4* src = input + image.x;
+
+    float4 sum = (float4)(0.0f);
+    for (int ky = -radius; ky <= radius; ky++) {
+        int iy = clamp(y + ky, 0, height - 1);
+
+        for (int kx = -radius; kx <= radius; kx++) {
+            sum += convert_float4(src[iy * width + clamp(x + kx, 0, width - 1)]);
+        }
+    }
+
+    const int side = 2 * radius + 1;
+    output[image.x + y * width + x] = store(sum / (float)(side * side));
+}
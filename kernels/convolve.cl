@@ -0,0 +1,174 @@
+// Generic convolution, built per matrix size with -D options:
+//   KERNEL_WIDTH, KERNEL_HEIGHT  matrix size, anchored at its centre
+//   TILE_SIZE                    work-group side of convolve_tiled
+//   WEIGHT_SPACE                 __constant, or __global for matrices beyond the constant buffer
+// The weights buffer holds the full matrix, followed by the row and column factors
+// when the matrix is separable.
+#ifndef WEIGHT_SPACE
+#define WEIGHT_SPACE __constant
+#endif
+#ifndef TILE_SIZE
+#define TILE_SIZE 16
+#endif
+#define ANCHOR_X (KERNEL_WIDTH / 2)
+#define ANCHOR_Y (KERNEL_HEIGHT / 2)
+#define ROW_OFFSET (KERNEL_WIDTH * KERNEL_HEIGHT)
+#define COLUMN_OFFSET (ROW_OFFSET + KERNEL_WIDTH)
+#define TILE_SPAN_X (TILE_SIZE + KERNEL_WIDTH - 1)
+#define TILE_SPAN_Y (TILE_SIZE + KERNEL_HEIGHT - 1)
+
+// Frame size baked in for fixed-size streams, otherwise the kernel arguments
+#ifdef WIDTH
+#define IMAGE_WIDTH WIDTH
+#define IMAGE_HEIGHT HEIGHT
+#else
+#define IMAGE_WIDTH width
+#define IMAGE_HEIGHT height
+#endif
+
+inline uchar4 store(float4 sum) {
+    uchar4 rgba = convert_uchar4_sat_rte(sum);
+    rgba.w = 255;
+    return rgba;
+}
+
+// Taps read straight from global memory; for small matrices, where caches catch the reuse
+__kernel void convolve(__global const uchar4* input,
+                       __global uchar4* output,
+                       const int width,
+                       const int height,
+                       WEIGHT_SPACE const float* weights) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= IMAGE_WIDTH || y >= IMAGE_HEIGHT)
+        return;
+
+    float4 sum = (float4)(0.0f);
+    for (int ky = 0; ky < KERNEL_HEIGHT; ky++) {
+        int iy = clamp(y + ky - ANCHOR_Y, 0, IMAGE_HEIGHT - 1);
+
+        for (int kx = 0; kx < KERNEL_WIDTH; kx++) {
+            int ix = clamp(x + kx - ANCHOR_X, 0, IMAGE_WIDTH - 1);
+            sum += convert_float4(input[iy * IMAGE_WIDTH + ix]) * weights[ky * KERNEL_WIDTH + kx];
+        }
+    }
+
+    output[y * IMAGE_WIDTH + x] = store(sum);
+}
+
+// Each work-group stages its tile plus the matrix footprint in local memory, so every
+// pixel is read from global memory about once however large the matrix is
+__kernel __attribute__((reqd_work_group_size(TILE_SIZE, TILE_SIZE, 1)))
+void convolve_tiled(__global const uchar4* input,
+                    __global uchar4* output,
+                    const int width,
+                    const int height,
+                    WEIGHT_SPACE const float* weights) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    const int lx = get_local_id(0);
+    const int ly = get_local_id(1);
+    const int originX = get_group_id(0) * TILE_SIZE - ANCHOR_X;
+    const int originY = get_group_id(1) * TILE_SIZE - ANCHOR_Y;
+
+    __local uchar4 tile[TILE_SPAN_Y][TILE_SPAN_X];
+
+    for (int ty = ly; ty < TILE_SPAN_Y; ty += TILE_SIZE) {
+        int iy = clamp(originY + ty, 0, IMAGE_HEIGHT - 1);
+
+        for (int tx = lx; tx < TILE_SPAN_X; tx += TILE_SIZE) {
+            int ix = clamp(originX + tx, 0, IMAGE_WIDTH - 1);
+            tile[ty][tx] = input[iy * IMAGE_WIDTH + ix];
+        }
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (x >= IMAGE_WIDTH || y >= IMAGE_HEIGHT)
+        return;
+
+    float4 sum = (float4)(0.0f);
+    for (int ky = 0; ky < KERNEL_HEIGHT; ky++) {
+        for (int kx = 0; kx < KERNEL_WIDTH; kx++) {
+            sum += convert_float4(tile[ly + ky][lx + kx]) * weights[ky * KERNEL_WIDTH + kx];
+        }
+    }
+
+    output[y * IMAGE_WIDTH + x] = store(sum);
+}
+
+// Horizontal pass of a separable matrix. The intermediate stays in float, as factors
+// such as those of Sobel produce negative values.
+__kernel void convolve_rows(__global const uchar4* input,
+                            __global float4* output,
+                            const int width,
+                            const int height,
+                            WEIGHT_SPACE const float* weights) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= IMAGE_WIDTH || y >= IMAGE_HEIGHT)
+        return;
+
+    __global const uchar4* row = input + y * IMAGE_WIDTH;
+
+    float4 sum = (float4)(0.0f);
+    for (int kx = 0; kx < KERNEL_WIDTH; kx++) {
+        int ix = clamp(x + kx - ANCHOR_X, 0, IMAGE_WIDTH - 1);
+        sum += convert_float4(row[ix]) * weights[ROW_OFFSET + kx];
+    }
+
+    output[y * IMAGE_WIDTH + x] = sum;
+}
+
+// Vertical pass of a separable matrix over the output of convolve_rows
+__kernel void convolve_columns(__global const float4* input,
+                               __global uchar4* output,
+                               const int width,
+                               const int height,
+                               WEIGHT_SPACE const float* weights) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= IMAGE_WIDTH || y >= IMAGE_HEIGHT)
+        return;
+
+    float4 sum = (float4)(0.0f);
+    for (int ky = 0; ky < KERNEL_HEIGHT; ky++) {
+        int iy = clamp(y + ky - ANCHOR_Y, 0, IMAGE_HEIGHT - 1);
+        sum += input[iy * IMAGE_WIDTH + x] * weights[COLUMN_OFFSET + ky];
+    }
+
+    output[y * IMAGE_WIDTH + x] = store(sum);
+}
+
+// Several images packed back to back in one buffer. Each entry of images holds
+// (pixel offset, width, height, unused); the third launch dimension selects the entry.
+__kernel void convolve_batched(__global const uchar4* input,
+                               __global uchar4* output,
+                               __global const int4* images,
+                               WEIGHT_SPACE const float* weights) {
+    const int4 image = images[get_global_id(2)];
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    const int width = image.y;
+    const int height = image.z;
+
+    if (x >= width || y >= height)
+        return;
+
+    __global const uchar4* src = input + image.x;
+
+    float4 sum = (float4)(0.0f);
+    for (int ky = 0; ky < KERNEL_HEIGHT; ky++) {
+        int iy = clamp(y + ky - ANCHOR_Y, 0, height - 1);
+
+        for (int kx = 0; kx < KERNEL_WIDTH; kx++) {
+            int ix = clamp(x + kx - ANCHOR_X, 0, width - 1);
+            sum += convert_float4(src[iy * width + ix]) * weights[ky * KERNEL_WIDTH + kx];
+        }
+    }
+
+    output[image.x + y * width + x] = store(sum);
+}
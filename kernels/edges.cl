@@ -0,0 +1,165 @@
+// Sobel gradients and Canny edges. Inputs are grayscale images as written by the
+// grayscale kernel (luma in every colour channel); edges are clamped.
+
+// Sobel derivatives of the 3x3 neighbourhood of (x, y), from the luma in .x
+inline float2 gradient(__global const uchar4* gray, const int x, const int y, const int width,
+                       const int height) {
+    const int x0 = max(x - 1, 0);
+    const int x1 = min(x + 1, width - 1);
+    const int y0 = max(y - 1, 0) * width;
+    const int y1 = y * width;
+    const int y2 = min(y + 1, height - 1) * width;
+
+    const float a = gray[y0 + x0].x, b = gray[y0 + x].x, c = gray[y0 + x1].x;
+    const float d = gray[y1 + x0].x, f = gray[y1 + x1].x;
+    const float g = gray[y2 + x0].x, h = gray[y2 + x].x, i = gray[y2 + x1].x;
+
+    return (float2)((c + 2.0f * f + i) - (a + 2.0f * d + g),
+                    (g + 2.0f * h + i) - (a + 2.0f * b + c));
+}
+
+// Gradient magnitude as a grayscale image
+__kernel void sobel(__global const uchar4* gray,
+                    __global uchar4* output,
+                    const int width,
+                    const int height) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= width || y >= height)
+        return;
+
+    const uchar value = convert_uchar_sat_rte(length(gradient(gray, x, y, width, height)));
+    output[y * width + x] = (uchar4)(value, value, value, 255);
+}
+
+// Magnitude and direction, quantised to the neighbour pair the gradient points
+// between: 0 horizontal, 1 down-right diagonal, 2 vertical, 3 down-left diagonal
+__kernel void canny_gradient(__global const uchar4* gray,
+                             __global float2* gradients,
+                             const int width,
+                             const int height) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= width || y >= height)
+        return;
+
+    const float2 g = gradient(gray, x, y, width, height);
+    const float ax = fabs(g.x);
+    const float ay = fabs(g.y);
+
+    // tan(22.5) and tan(67.5) bound the sectors
+    float sector;
+    if (ay <= 0.41421356f * ax)
+        sector = 0.0f;
+    else if (ay >= 2.41421356f * ax)
+        sector = 2.0f;
+    else
+        sector = g.x * g.y > 0.0f ? 1.0f : 3.0f;
+
+    gradients[y * width + x] = (float2)(length(g), sector);
+}
+
+#define STRONG 255
+#define WEAK 128
+
+// Non-maximum suppression and double threshold: pixels that are not the largest
+// along their gradient are dropped, the rest become strong above high, weak above low
+__kernel void canny_suppress(__global const float2* gradients,
+                             __global uchar4* edges,
+                             const int width,
+                             const int height,
+                             const float low,
+                             const float high) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= width || y >= height)
+        return;
+
+    const float2 g = gradients[y * width + x];
+    const int sector = (int)g.y;
+    const int dx = sector == 2 ? 0 : (sector == 3 ? -1 : 1);
+    const int dy = sector == 0 ? 0 : 1;
+
+    const float ahead = gradients[clamp(y + dy, 0, height - 1) * width + clamp(x + dx, 0, width - 1)].x;
+    const float behind = gradients[clamp(y - dy, 0, height - 1) * width + clamp(x - dx, 0, width - 1)].x;
+
+    uchar value = 0;
+    if (g.x >= ahead && g.x >= behind) {
+        value = g.x >= high ? STRONG : (g.x >= low ? WEAK : 0);
+    }
+    edges[y * width + x] = (uchar4)(value, value, value, 255);
+}
+
+// One hysteresis pass: weak pixels next to a strong one become strong. Passes update
+// in place, which only speeds up the spread, and raise changed until nothing changes.
+__kernel void canny_hysteresis(__global uchar4* edges,
+                               const int width,
+                               const int height,
+                               __global int* changed) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= width || y >= height || edges[y * width + x].x != WEAK)
+        return;
+
+    for (int ny = max(y - 1, 0); ny <= min(y + 1, height - 1); ny++) {
+        for (int nx = max(x - 1, 0); nx <= min(x + 1, width - 1); nx++) {
+            if (edges[ny * width + nx].x == STRONG) {
+                edges[y * width + x] = (uchar4)(STRONG, STRONG, STRONG, 255);
+                *changed = 1;
+                return;
+            }
+        }
+    }
+}
+
+// Drops the weak pixels no strong edge reached
+__kernel void canny_finish(__global uchar4* edges,
+                           const int width,
+                           const int height) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= width || y >= height)
+        return;
+
+    if (edges[y * width + x].x == WEAK)
+        edges[y * width + x] = (uchar4)(0, 0, 0, 255);
+}
+
+// Several images packed back to back, described by images as in gaussian_blur_batched.
+// Small images are converted to luma in place of a separate grayscale launch.
+__kernel void sobel_batched(__global const uchar4* input,
+                            __global uchar4* output,
+                            __global const int4* images) {
+    const int4 image = images[get_global_id(2)];
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    const int width = image.y;
+    const int height = image.z;
+
+    if (x >= width || y >= height)
+        return;
+
+    __global const uchar4* src = input + image.x;
+
+    float luma[3][3];
+    for (int ky = 0; ky < 3; ky++) {
+        int iy = clamp(y + ky - 1, 0, height - 1);
+
+        for (int kx = 0; kx < 3; kx++) {
+            const uchar4 rgba = src[iy * width + clamp(x + kx - 1, 0, width - 1)];
+            // Rec. 601 luma, truncated as in grayscale.cl
+            luma[ky][kx] = (uchar)dot(convert_float3(rgba.xyz), (float3)(0.299f, 0.587f, 0.114f));
+        }
+    }
+
+    const float gx = (luma[0][2] + 2.0f * luma[1][2] + luma[2][2]) - (luma[0][0] + 2.0f * luma[1][0] + luma[2][0]);
+    const float gy = (luma[2][0] + 2.0f * luma[2][1] + luma[2][2]) - (luma[0][0] + 2.0f * luma[0][1] + luma[0][2]);
+    const uchar value = convert_uchar_sat_rte(length((float2)(gx, gy)));
+
+    output[image.x + y * width + x] = (uchar4)(value, value, value, 255);
+}
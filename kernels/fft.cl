@@ -0,0 +1,100 @@
+// FFT convolution over three complex planes (R, G, B) of paddedWidth x paddedHeight,
+// padded so that the circular convolution equals the linear one with clamped edges.
+
+// Replicates edge pixels into the padding; the image starts at (anchorX, anchorY)
+__kernel void fft_pad(__global const uchar4* input,
+                      __global float2* planes,
+                      const int width,
+                      const int height,
+                      const int paddedWidth,
+                      const int paddedHeight,
+                      const int anchorX,
+                      const int anchorY) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= paddedWidth || y >= paddedHeight)
+        return;
+
+    const int ix = clamp(x - anchorX, 0, width - 1);
+    const int iy = clamp(y - anchorY, 0, height - 1);
+    const float4 rgba = convert_float4(input[iy * width + ix]);
+    const int plane = paddedWidth * paddedHeight;
+    const int idx = y * paddedWidth + x;
+
+    planes[idx] = (float2)(rgba.x, 0.0f);
+    planes[plane + idx] = (float2)(rgba.y, 0.0f);
+    planes[2 * plane + idx] = (float2)(rgba.z, 0.0f);
+}
+
+// One radix-2 Stockham pass over lines of n elements, elementStride apart; lines are
+// lineStride apart and planes planeStride apart. Runs for p = 1, 2, ..., n / 2, with
+// input and output swapped between passes; sign is -1 forward and 1 inverse.
+__kernel void fft_radix2(__global const float2* input,
+                         __global float2* output,
+                         const int n,
+                         const int lines,
+                         const int p,
+                         const float sign,
+                         const int elementStride,
+                         const int lineStride,
+                         const int planeStride) {
+    const int i = get_global_id(0);
+    const int line = get_global_id(1);
+
+    if (i >= n / 2 || line >= lines)
+        return;
+
+    const int base = get_global_id(2) * planeStride + line * lineStride;
+    const int k = i & (p - 1);
+
+    float2 u0 = input[base + i * elementStride];
+    float2 u1 = input[base + (i + n / 2) * elementStride];
+
+    float c;
+    const float s = sincos(sign * M_PI_F * k / p, &c);
+    u1 = (float2)(u1.x * c - u1.y * s, u1.x * s + u1.y * c);
+
+    const int j = (i << 1) - k;
+    output[base + j * elementStride] = u0 + u1;
+    output[base + (j + p) * elementStride] = u0 - u1;
+}
+
+// Pointwise product of every plane with the matrix spectrum
+__kernel void fft_multiply(__global float2* planes,
+                           __global const float2* spectrum,
+                           const int planeSize) {
+    const int idx = get_global_id(0);
+
+    if (idx >= 3 * planeSize)
+        return;
+
+    const float2 a = planes[idx];
+    const float2 b = spectrum[idx % planeSize];
+    planes[idx] = (float2)(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+// Crops the image back out of the planes; scale undoes the unnormalised inverse transform
+__kernel void fft_unpack(__global const float2* planes,
+                         __global uchar4* output,
+                         const int width,
+                         const int height,
+                         const int paddedWidth,
+                         const int paddedHeight,
+                         const int anchorX,
+                         const int anchorY,
+                         const float scale) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= width || y >= height)
+        return;
+
+    const int plane = paddedWidth * paddedHeight;
+    const int idx = (y + anchorY) * paddedWidth + x + anchorX;
+    const float4 rgba = (float4)(planes[idx].x, planes[plane + idx].x, planes[2 * plane + idx].x, 0.0f) * scale;
+
+    uchar4 out = convert_uchar4_sat_rte(rgba);
+    out.w = 255;
+    output[y * width + x] = out;
+}
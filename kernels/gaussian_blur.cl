@@ -1,45 +1,164 @@
+// Defaults for the values the host can fix at build time with -D options
+#ifndef TILE_SIZE
 #define TILE_SIZE 16
+#endif
+#ifndef KERNEL_RADIUS
 #define KERNEL_RADIUS 2
+#endif
 #define KERNEL_SIZE (2 * KERNEL_RADIUS + 1)
+#define TILE_SPAN (TILE_SIZE + 2 * KERNEL_RADIUS)
 
-__kernel void gaussian_blur(__global const uchar4* input, 
-                            __global uchar4* output, 
-                            const int width, 
-                            const int height, 
-                            __constant float* mkernel) {
+// Frame size baked in for fixed-size streams, otherwise the kernel arguments
+#ifdef WIDTH
+#define IMAGE_WIDTH WIDTH
+#define IMAGE_HEIGHT HEIGHT
+#else
+#define IMAGE_WIDTH width
+#define IMAGE_HEIGHT height
+#endif
+
+// Tap arithmetic: fp32 by default, fp16 or fixed point with FIXED_SHIFT fraction bits
+// when the program is built with PRECISION_FP16 or PRECISION_FIXED. Every mode rounds
+// to nearest, so they agree to within the rounding of the weights.
+#if defined(PRECISION_FP16)
+#pragma OPENCL EXTENSION cl_khr_fp16 : enable
+typedef float weight_t;
+typedef half4 acc4;
+#define TAP(rgba, w) (convert_half4(rgba) * (half)(w))
+#define RESULT(sum) convert_uchar4_sat_rte(sum)
+#elif defined(PRECISION_FIXED)
+#define FIXED_SHIFT 14
+typedef int weight_t;
+typedef int4 acc4;
+#define TAP(rgba, w) (convert_int4(rgba) * (w))
+#define RESULT(sum) convert_uchar4_sat(((sum) + (1 << (FIXED_SHIFT - 1))) >> FIXED_SHIFT)
+#else
+typedef float weight_t;
+typedef float4 acc4;
+#define TAP(rgba, w) (convert_float4(rgba) * (w))
+#define RESULT(sum) convert_uchar4_sat_rte(sum)
+#endif
+
+// Constant weights let the compiler fold every tap into an immediate. In fixed
+// point they are given pre-scaled by 1 << FIXED_SHIFT.
+#ifdef WEIGHTS
+__constant weight_t weights[KERNEL_SIZE * KERNEL_SIZE] = {WEIGHTS};
+#define WEIGHT(i) weights[i]
+#elif defined(PRECISION_FIXED)
+#define WEIGHT(i) convert_int_rte(mkernel[i] * (1 << FIXED_SHIFT))
+#else
+#define WEIGHT(i) mkernel[i]
+#endif
+
+// Each work-group loads its tile plus a halo of KERNEL_RADIUS pixels, clamped to
+// the image edges, so taps near the tile border read their real neighbours
+__kernel __attribute__((reqd_work_group_size(TILE_SIZE, TILE_SIZE, 1)))
+void gaussian_blur(__global const uchar4* input,
+                   __global uchar4* output,
+                   const int width,
+                   const int height,
+                   __constant float* mkernel) {
     const int x = get_global_id(0);
     const int y = get_global_id(1);
     const int lx = get_local_id(0);  // Local x
     const int ly = get_local_id(1);  // Local y
-    const int idx = y * width + x;
+    const int originX = get_group_id(0) * TILE_SIZE - KERNEL_RADIUS;
+    const int originY = get_group_id(1) * TILE_SIZE - KERNEL_RADIUS;
+
+    __local uchar4 tile[TILE_SPAN][TILE_SPAN];
 
-    if (x >= width || y >= height) 
-		return;
+    for (int ty = ly; ty < TILE_SPAN; ty += TILE_SIZE) {
+        int iy = clamp(originY + ty, 0, IMAGE_HEIGHT - 1);
 
-    __local uchar4 tile[TILE_SIZE][TILE_SIZE];
+        for (int tx = lx; tx < TILE_SPAN; tx += TILE_SIZE) {
+            int ix = clamp(originX + tx, 0, IMAGE_WIDTH - 1);
+            tile[ty][tx] = input[iy * IMAGE_WIDTH + ix];
+        }
+    }
 
-    tile[ly][lx] = input[idx];
-    
+    // Every work-item has to reach the barrier, so out of range ones leave after it
     barrier(CLK_LOCAL_MEM_FENCE);
-    
+
+    if (x >= IMAGE_WIDTH || y >= IMAGE_HEIGHT)
+        return;
+
+    acc4 sum = (acc4)(0);
+    for (int ky = 0; ky < KERNEL_SIZE; ky++) {
+        for (int kx = 0; kx < KERNEL_SIZE; kx++) {
+            sum += TAP(tile[ly + ky][lx + kx], WEIGHT(ky * KERNEL_SIZE + kx));
+        }
+    }
+
+    uchar4 rgba = RESULT(sum);
+    rgba.w = 255;
+    output[y * IMAGE_WIDTH + x] = rgba;
+}
+
+// Several images packed back to back in one buffer. Each entry of images holds
+// (pixel offset, width, height, unused); the third launch dimension selects the entry.
+// Small images gain little from tiling, so taps are read directly and clamped to
+// the edges of their own image.
+__kernel void gaussian_blur_batched(__global const uchar4* input,
+                                    __global uchar4* output,
+                                    __global const int4* images,
+                                    __constant float* mkernel) {
+    const int4 image = images[get_global_id(2)];
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    const int width = image.y;
+    const int height = image.z;
+
+    if (x >= width || y >= height)
+        return;
+
+    __global const uchar4* src = input + image.x;
+
+    acc4 sum = (acc4)(0);
+    for (int ky = -KERNEL_RADIUS; ky <= KERNEL_RADIUS; ky++) {
+        int kernel_y = (ky + KERNEL_RADIUS) * KERNEL_SIZE;
+        int iy = clamp(y + ky, 0, height - 1);
+
+        for (int kx = -KERNEL_RADIUS; kx <= KERNEL_RADIUS; kx++) {
+            int ix = clamp(x + kx, 0, width - 1);
+
+            sum += TAP(src[iy * width + ix], WEIGHT(kernel_y + (kx + KERNEL_RADIUS)));
+        }
+    }
+
+    uchar4 rgba = RESULT(sum);
+    rgba.w = 255;
+    output[image.x + y * width + x] = rgba;
+}
+
+// Clamp-to-edge borders come from the sampler and uchar to float conversion from
+// the texture unit, so no tile or index clamping is needed. Samples are normalised
+// floats, so this path exists in fp32 builds only.
+#if !defined(PRECISION_FP16) && !defined(PRECISION_FIXED)
+__constant sampler_t clampSampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+
+__kernel void gaussian_blur_image(__read_only image2d_t input,
+                                  __global uchar4* output,
+                                  const int width,
+                                  const int height,
+                                  __constant float* mkernel) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= IMAGE_WIDTH || y >= IMAGE_HEIGHT)
+        return;
+
     float4 sum = (float4)(0.0f, 0.0f, 0.0f, 0.0f);
     for (int ky = -KERNEL_RADIUS; ky <= KERNEL_RADIUS; ky++) {
         int kernel_y = (ky + KERNEL_RADIUS) * KERNEL_SIZE;
-        
+
         for (int kx = -KERNEL_RADIUS; kx <= KERNEL_RADIUS; kx++) {
-            int ix = clamp(lx + kx, 0, TILE_SIZE - 1);
-            int iy = clamp(ly + ky, 0, TILE_SIZE - 1);
-            
-            uchar4 rgba = tile[iy][ix];
-            
-            float weight = mkernel[kernel_y + (kx + KERNEL_RADIUS)];
-            sum += convert_float4(rgba) * weight;
+            float weight = WEIGHT(kernel_y + (kx + KERNEL_RADIUS));
+            sum += read_imagef(input, clampSampler, (int2)(x + kx, y + ky)) * weight;
         }
     }
 
-    output[idx] = (uchar4)(
-        clamp(sum.x, 0.0f, 255.0f), 
-        clamp(sum.y, 0.0f, 255.0f), 
-        clamp(sum.z, 0.0f, 255.0f), 
-        255);
-}
\ No newline at end of file
+    uchar4 rgba = convert_uchar4_sat_rte(sum * 255.0f);
+    rgba.w = 255;
+    output[y * IMAGE_WIDTH + x] = rgba;
+}
+#endif
@@ -1,3 +1,18 @@
+// Frame size and pixels per work-item baked in at build time with -D options,
+// otherwise the kernel arguments
+#ifdef WIDTH
+#define IMAGE_WIDTH WIDTH
+#define IMAGE_HEIGHT HEIGHT
+#define PIXEL_COUNT (WIDTH * HEIGHT)
+#else
+#define IMAGE_WIDTH width
+#define IMAGE_HEIGHT height
+#define PIXEL_COUNT pixels
+#endif
+#ifndef VECTORS
+#define VECTORS vectors
+#endif
+
 __kernel void grayscale(__global const uchar4* input,
                         __global uchar4* output,
                         const int width,
@@ -5,10 +20,31 @@ __kernel void grayscale(__global const uchar4* input,
     const int x = get_global_id(0);
     const int y = get_global_id(1);
 
-    if (x >= width || y >= height)
+    if (x >= IMAGE_WIDTH || y >= IMAGE_HEIGHT)
+        return;
+
+    const int idx = (y * IMAGE_WIDTH + x);
+
+    uchar4 rgba = input[idx];
+
+    uchar gray = (uchar)dot(convert_float3(rgba.xyz), (float3)(0.299f, 0.587f, 0.114f));
+
+    output[idx] = (uchar4)(gray, gray, gray, 255);
+}
+
+// Several images packed back to back in one buffer. Each entry of images holds
+// (pixel offset, width, height, unused); the third launch dimension selects the entry.
+__kernel void grayscale_batched(__global const uchar4* input,
+                                __global uchar4* output,
+                                __global const int4* images) {
+    const int4 image = images[get_global_id(2)];
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= image.y || y >= image.z)
         return;
 
-    const int idx = (y * width + x);
+    const int idx = image.x + y * image.y + x;
 
     uchar4 rgba = input[idx];
 
@@ -16,3 +52,37 @@ __kernel void grayscale(__global const uchar4* input,
 
     output[idx] = (uchar4)(gray, gray, gray, 255);
 }
+
+// Flat 1D variant for wide SIMD devices: each work-item converts `vectors` groups of
+// four pixels with vload16/vstore16, and the last one finishes the pixels that do not
+// fill a group one at a time.
+__kernel void grayscale_vec(__global const uchar4* input,
+                            __global uchar4* output,
+                            const int pixels,
+                            const int vectors) {
+    __global const uchar* src = (__global const uchar*)input;
+    __global uchar* dst = (__global uchar*)output;
+    const int base = get_global_id(0) * VECTORS * 4;
+
+    for (int v = 0; v < VECTORS; v++) {
+        const int p = base + v * 4;
+
+        if (p + 4 <= PIXEL_COUNT) {
+            uchar16 rgba = vload16(0, src + p * 4);
+            uchar4 gray = convert_uchar4(convert_float4(rgba.s048c) * 0.299f +
+                                         convert_float4(rgba.s159d) * 0.587f +
+                                         convert_float4(rgba.s26ae) * 0.114f);
+            uchar16 out = (uchar16)(gray.s0, gray.s0, gray.s0, 255, gray.s1, gray.s1, gray.s1, 255,
+                                    gray.s2, gray.s2, gray.s2, 255, gray.s3, gray.s3, gray.s3, 255);
+            vstore16(out, 0, dst + p * 4);
+            continue;
+        }
+
+        for (int i = p; i < PIXEL_COUNT; i++) {
+            uchar4 rgba = input[i];
+            uchar gray = (uchar)dot(convert_float3(rgba.xyz), (float3)(0.299f, 0.587f, 0.114f));
+            output[i] = (uchar4)(gray, gray, gray, 255);
+        }
+        return;
+    }
+}
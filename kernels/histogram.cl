@@ -0,0 +1,161 @@
+// Luma histograms and equalisation. Work-groups count into a histogram in local
+// memory with atomics and merge it into the global one once, so global atomics are
+// per bin and work-group rather than per pixel. Equalisation remaps the luma and
+// keeps the chroma, shifting R, G and B by the same amount.
+
+// Rec. 601 luma; bins take its integer part, the level grayscale.cl writes
+inline float luma(uchar4 rgba) {
+    return dot(convert_float3(rgba.xyz), (float3)(0.299f, 0.587f, 0.114f));
+}
+
+inline uchar4 withLuma(uchar4 rgba, float from, float to) {
+    return (uchar4)(convert_uchar3_sat_rte(convert_float3(rgba.xyz) + (to - from)), rgba.w);
+}
+
+inline void clearBins(__local uint* bins) {
+    for (int i = get_local_id(0); i < 256; i += get_local_size(0)) {
+        bins[i] = 0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+// Histogram of every pixel, added to bins, which must start zeroed. Any number of
+// work-groups stride over the image.
+__kernel void histogram(__global const uchar4* input,
+                        __global uint* bins,
+                        const int pixels) {
+    __local uint localBins[256];
+    clearBins(localBins);
+
+    for (int i = get_global_id(0); i < pixels; i += get_global_size(0)) {
+        atomic_inc(&localBins[(uchar)luma(input[i])]);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int i = get_local_id(0); i < 256; i += get_local_size(0)) {
+        if (localBins[i])
+            atomic_add(&bins[i], localBins[i]);
+    }
+}
+
+// Cumulative histogram scaled to 0-255, the first occupied level mapping to 0.
+// 256 sequential steps; run as a single work-item.
+__kernel void equalise_lut(__global const uint* bins,
+                           __global uchar* lut,
+                           const int pixels) {
+    uint first = 0;
+    for (int i = 0; i < 256 && !first; i++) {
+        first = bins[i];
+    }
+
+    const float scale = pixels > first ? 255.0f / (pixels - first) : 0.0f;
+    uint sum = 0;
+    for (int i = 0; i < 256; i++) {
+        sum += bins[i];
+        lut[i] = convert_uchar_sat_rte(sum > first ? (sum - first) * scale : 0.0f);
+    }
+}
+
+__kernel void equalise(__global const uchar4* input,
+                       __global uchar4* output,
+                       __global const uchar* lut,
+                       const int pixels) {
+    const int i = get_global_id(0);
+
+    if (i >= pixels)
+        return;
+
+    const uchar4 rgba = input[i];
+    const float y = luma(rgba);
+    output[i] = withLuma(rgba, y, lut[(uchar)y]);
+}
+
+// CLAHE: one work-group per tile of a tilesX x tilesY grid builds the tile's histogram,
+// clips bins at clip times the average and spreads the excess evenly, then writes
+// the tile's equalisation table to luts.
+__kernel void clahe_lut(__global const uchar4* input,
+                        __global uchar* luts,
+                        const int width,
+                        const int height,
+                        const int tilesX,
+                        const int tilesY,
+                        const float clip) {
+    const int tile = get_group_id(0);
+    const int tx = tile % tilesX;
+    const int ty = tile / tilesX;
+    const int x0 = tx * width / tilesX;
+    const int y0 = ty * height / tilesY;
+    const int tileWidth = (tx + 1) * width / tilesX - x0;
+    const int area = tileWidth * ((ty + 1) * height / tilesY - y0);
+
+    __local uint bins[256];
+    __local uint excess;
+    clearBins(bins);
+    if (get_local_id(0) == 0)
+        excess = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int i = get_local_id(0); i < area; i += get_local_size(0)) {
+        const uchar4 rgba = input[(y0 + i / tileWidth) * width + x0 + i % tileWidth];
+        atomic_inc(&bins[(uchar)luma(rgba)]);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    const uint limit = max((uint)(clip * area / 256), 1u);
+    for (int i = get_local_id(0); i < 256; i += get_local_size(0)) {
+        if (bins[i] > limit) {
+            atomic_add(&excess, bins[i] - limit);
+            bins[i] = limit;
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (get_local_id(0) != 0)
+        return;
+
+    // The remainder of the excess goes to the lowest bins, one each
+    const uint share = excess / 256;
+    const uint remainder = excess % 256;
+    const float scale = area > 0 ? 255.0f / area : 0.0f;
+    uint sum = 0;
+    for (int i = 0; i < 256; i++) {
+        sum += bins[i] + share + (i < remainder);
+        luts[tile * 256 + i] = convert_uchar_sat_rte(sum * scale);
+    }
+}
+
+// Interpolates between the tables of the four tiles whose centres surround each
+// pixel, so tile borders do not show
+__kernel void clahe(__global const uchar4* input,
+                    __global uchar4* output,
+                    __global const uchar* luts,
+                    const int width,
+                    const int height,
+                    const int tilesX,
+                    const int tilesY) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= width || y >= height)
+        return;
+
+    const float gx = (x + 0.5f) * tilesX / width - 0.5f;
+    const float gy = (y + 0.5f) * tilesY / height - 0.5f;
+    const int tx0 = clamp((int)floor(gx), 0, tilesX - 1);
+    const int ty0 = clamp((int)floor(gy), 0, tilesY - 1);
+    const int tx1 = min(tx0 + 1, tilesX - 1);
+    const int ty1 = min(ty0 + 1, tilesY - 1);
+    const float wx = clamp(gx - tx0, 0.0f, 1.0f);
+    const float wy = clamp(gy - ty0, 0.0f, 1.0f);
+
+    const uchar4 rgba = input[y * width + x];
+    const float value = luma(rgba);
+    const int level = (uchar)value;
+
+    const float top = mix((float)luts[(ty0 * tilesX + tx0) * 256 + level],
+                          (float)luts[(ty0 * tilesX + tx1) * 256 + level], wx);
+    const float bottom = mix((float)luts[(ty1 * tilesX + tx0) * 256 + level],
+                             (float)luts[(ty1 * tilesX + tx1) * 256 + level], wx);
+
+    output[y * width + x] = withLuma(rgba, value, mix(top, bottom, wy));
+}
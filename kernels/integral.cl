@@ -0,0 +1,200 @@
+// Summed-area table: entry (x, y) holds the sums of R, G, B and luma over the
+// rectangle from (0, 0) to (x, y) inclusive, so any window sum costs four reads.
+// Built with -D options:
+//   SCAN_SIZE  work-group size of integral_rows, a power of two
+//   WIDE_SUM   64-bit sums, for images whose total can exceed 32 bits
+#ifndef SCAN_SIZE
+#define SCAN_SIZE 256
+#endif
+
+#ifdef WIDE_SUM
+typedef ulong4 sum4;
+#define CONVERT_SUM convert_ulong4
+#else
+typedef uint4 sum4;
+#define CONVERT_SUM convert_uint4
+#endif
+
+// Rec. 601 luma, matching grayscale.cl
+inline uchar luma(uchar4 rgba) {
+    return (uchar)dot(convert_float3(rgba.xyz), (float3)(0.299f, 0.587f, 0.114f));
+}
+
+inline sum4 channels(uchar4 rgba) {
+    rgba.w = luma(rgba);
+    return CONVERT_SUM(rgba);
+}
+
+// One work-group per row scans SCAN_SIZE pixels at a time in local memory
+// (Hillis-Steele, log2(SCAN_SIZE) steps) and carries the total into the next chunk
+__kernel __attribute__((reqd_work_group_size(SCAN_SIZE, 1, 1)))
+void integral_rows(__global const uchar4* input,
+                   __global sum4* table,
+                   const int width,
+                   const int height) {
+    const int y = get_group_id(0);
+    const int lid = get_local_id(0);
+
+    __local sum4 scan[2][SCAN_SIZE];
+
+    sum4 carry = (sum4)(0);
+    for (int base = 0; base < width; base += SCAN_SIZE) {
+        const int x = base + lid;
+        int in = 0;
+
+        scan[0][lid] = x < width ? channels(input[y * width + x]) : (sum4)(0);
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int offset = 1; offset < SCAN_SIZE; offset <<= 1) {
+            sum4 value = scan[in][lid];
+            if (lid >= offset)
+                value += scan[in][lid - offset];
+            scan[1 - in][lid] = value;
+            in = 1 - in;
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+
+        if (x < width)
+            table[y * width + x] = carry + scan[in][lid];
+        carry += scan[in][SCAN_SIZE - 1];
+
+        // The next chunk overwrites scan[0], which may still be read above
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
+// Adds up the row sums down each column in place; neighbouring work-items take
+// neighbouring columns, so each step touches one contiguous row segment
+__kernel void integral_columns(__global sum4* table,
+                               const int width,
+                               const int height) {
+    const int x = get_global_id(0);
+
+    if (x >= width)
+        return;
+
+    sum4 sum = (sum4)(0);
+    for (int y = 0; y < height; y++) {
+        sum += table[y * width + x];
+        table[y * width + x] = sum;
+    }
+}
+
+// Sum over the inclusive window (x0, y0) - (x1, y1), which must lie inside the image.
+// Differences of unsigned sums are exact even when intermediate terms wrap.
+inline sum4 window(__global const sum4* table, const int width, int x0, int y0, int x1, int y1) {
+    sum4 sum = table[y1 * width + x1];
+    if (x0 > 0)
+        sum -= table[y1 * width + x0 - 1];
+    if (y0 > 0)
+        sum -= table[(y0 - 1) * width + x1];
+    if (x0 > 0 && y0 > 0)
+        sum += table[(y0 - 1) * width + x0 - 1];
+    return sum;
+}
+
+// Bradley's adaptive threshold: white where the luma exceeds the mean of the
+// surrounding (2 * radius + 1)^2 window, cropped to the image, times 1 - bias
+__kernel void adaptive_threshold(__global const uchar4* input,
+                                 __global uchar4* output,
+                                 __global const sum4* table,
+                                 const int width,
+                                 const int height,
+                                 const int radius,
+                                 const float bias) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= width || y >= height)
+        return;
+
+    const int x0 = max(x - radius, 0);
+    const int y0 = max(y - radius, 0);
+    const int x1 = min(x + radius, width - 1);
+    const int y1 = min(y + radius, height - 1);
+    const float area = (x1 - x0 + 1) * (y1 - y0 + 1);
+
+    const float mean = (float)window(table, width, x0, y0, x1, y1).w / area;
+    const uchar value = luma(input[y * width + x]) > mean * (1.0f - bias) ? 255 : 0;
+
+    output[y * width + x] = (uchar4)(value, value, value, 255);
+}
+
+// Box blur from the table: the average of the (2 * radius + 1)^2 window with edges
+// clamped, like box_rows and box_columns. Window positions past an edge repeat the
+// edge pixel, so the edge row, column or corner inside the window is added once more
+// for each of them. Sums are exact, so only the final division rounds.
+__kernel void box_blur_table(__global const sum4* table,
+                             __global uchar4* output,
+                             const int width,
+                             const int height,
+                             const int radius) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= width || y >= height)
+        return;
+
+    const int x0 = max(x - radius, 0);
+    const int y0 = max(y - radius, 0);
+    const int x1 = min(x + radius, width - 1);
+    const int y1 = min(y + radius, height - 1);
+    const int w = width - 1;
+    const int h = height - 1;
+
+    const sum4 left = (sum4)(max(radius - x, 0));
+    const sum4 right = (sum4)(max(x + radius - w, 0));
+    const sum4 top = (sum4)(max(radius - y, 0));
+    const sum4 bottom = (sum4)(max(y + radius - h, 0));
+
+    const sum4 sum = window(table, width, x0, y0, x1, y1) +
+                     left * window(table, width, 0, y0, 0, y1) +
+                     right * window(table, width, w, y0, w, y1) +
+                     top * window(table, width, x0, 0, x1, 0) +
+                     bottom * window(table, width, x0, h, x1, h) +
+                     left * top * window(table, width, 0, 0, 0, 0) +
+                     right * top * window(table, width, w, 0, w, 0) +
+                     left * bottom * window(table, width, 0, h, 0, h) +
+                     right * bottom * window(table, width, w, h, w, h);
+
+    const int side = 2 * radius + 1;
+    uchar4 rgba = convert_uchar4_sat_rte(convert_float4(sum) / (float)(side * side));
+    rgba.w = 255;
+    output[y * width + x] = rgba;
+}
+
+// Several images packed back to back, described by images as in gaussian_blur_batched.
+// Batched images are small, so the window is summed directly instead of through a table.
+__kernel void adaptive_threshold_batched(__global const uchar4* input,
+                                         __global uchar4* output,
+                                         __global const int4* images,
+                                         const int radius,
+                                         const float bias) {
+    const int4 image = images[get_global_id(2)];
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    const int width = image.y;
+    const int height = image.z;
+
+    if (x >= width || y >= height)
+        return;
+
+    __global const uchar4* src = input + image.x;
+
+    const int x0 = max(x - radius, 0);
+    const int y0 = max(y - radius, 0);
+    const int x1 = min(x + radius, width - 1);
+    const int y1 = min(y + radius, height - 1);
+
+    uint sum = 0;
+    for (int iy = y0; iy <= y1; iy++) {
+        for (int ix = x0; ix <= x1; ix++) {
+            sum += luma(src[iy * width + ix]);
+        }
+    }
+
+    const float mean = (float)sum / ((x1 - x0 + 1) * (y1 - y0 + 1));
+    const uchar value = luma(src[y * width + x]) > mean * (1.0f - bias) ? 255 : 0;
+
+    output[image.x + y * width + x] = (uchar4)(value, value, value, 255);
+}
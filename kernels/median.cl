@@ -0,0 +1,231 @@
+// Median filter, per channel, over a (2 * RADIUS + 1)^2 window with clamped edges.
+// Built with -D options:
+//   RADIUS        window radius
+//   MEDIAN_GROUP  work-group size of median_histogram, a power of two up to 256
+// Small windows sort in registers with a sorting network; larger ones keep
+// histograms per column and take constant time per pixel at any radius.
+#ifndef RADIUS
+#define RADIUS 1
+#endif
+#ifndef MEDIAN_GROUP
+#define MEDIAN_GROUP 64
+#endif
+#define SIZE (2 * RADIUS + 1)
+#define WINDOW (SIZE * SIZE)
+
+// Batcher's odd-even merge sort over the WINDOW values of v, as compare-exchanges
+// with indices fixed at compile time, so v stays in registers and there are no
+// branches. Channel-wise min/max sorts every channel (and pixel, for wider types) at
+// once; exchanges that do not lead to the middle element are removed as dead code.
+#define SORT_NETWORK(T, v)                                                        \
+    _Pragma("unroll") for (int p = 1; p < WINDOW; p <<= 1)                      \
+    _Pragma("unroll") for (int k = p; k >= 1; k >>= 1)                          \
+    _Pragma("unroll") for (int j = k % p; j + k < WINDOW; j += 2 * k)           \
+    _Pragma("unroll") for (int i = 0; i < min(k, WINDOW - j - k); i++)          \
+        if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {                       \
+            const T low = min(v[i + j], v[i + j + k]);                          \
+            v[i + j + k] = max(v[i + j], v[i + j + k]);                         \
+            v[i + j] = low;                                                     \
+        }
+
+// Networks grow with the window, so they are only compiled for the radii the host
+// runs them at, up to Engine::MEDIAN_NETWORK_RADIUS
+#if RADIUS <= 2
+inline uchar4 medianAt(__global const uchar4* input, const int x, const int y, const int width,
+                       const int height) {
+    uchar4 v[WINDOW];
+    for (int ky = 0; ky < SIZE; ky++) {
+        int iy = clamp(y + ky - RADIUS, 0, height - 1);
+
+        for (int kx = 0; kx < SIZE; kx++) {
+            v[ky * SIZE + kx] = input[iy * width + clamp(x + kx - RADIUS, 0, width - 1)];
+        }
+    }
+
+    SORT_NETWORK(uchar4, v)
+
+    uchar4 rgba = v[WINDOW / 2];
+    rgba.w = 255;
+    return rgba;
+}
+
+__kernel void median(__global const uchar4* input,
+                     __global uchar4* output,
+                     const int width,
+                     const int height) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= width || y >= height)
+        return;
+
+    output[y * width + x] = medianAt(input, x, y, width, height);
+}
+
+// Four adjacent pixels per work-item for wide SIMD devices: the network runs on
+// uchar16, sorting the windows of all four at once. Groups touching the left or
+// right edge take the per-pixel path for their clamping.
+__kernel void median_vec(__global const uchar4* input,
+                         __global uchar4* output,
+                         const int width,
+                         const int height) {
+    const int x = get_global_id(0) * 4;
+    const int y = get_global_id(1);
+
+    if (x >= width || y >= height)
+        return;
+
+    if (x < RADIUS || x + 3 + RADIUS >= width) {
+        for (int i = x; i < min(x + 4, width); i++) {
+            output[y * width + i] = medianAt(input, i, y, width, height);
+        }
+        return;
+    }
+
+    uchar16 v[WINDOW];
+    for (int ky = 0; ky < SIZE; ky++) {
+        __global const uchar4* row = input + clamp(y + ky - RADIUS, 0, height - 1) * width;
+
+        for (int kx = 0; kx < SIZE; kx++) {
+            v[ky * SIZE + kx] = vload16(0, (__global const uchar*)(row + x + kx - RADIUS));
+        }
+    }
+
+    SORT_NETWORK(uchar16, v)
+
+    uchar16 rgba = v[WINDOW / 2];
+    rgba.s37bf = (uchar4)(255);
+    vstore16(rgba, 0, (__global uchar*)(output + y * width + x));
+}
+
+// Several images packed back to back, described by images as in gaussian_blur_batched
+__kernel void median_batched(__global const uchar4* input,
+                             __global uchar4* output,
+                             __global const int4* images) {
+    const int4 image = images[get_global_id(2)];
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= image.y || y >= image.z)
+        return;
+
+    output[image.x + y * image.y + x] = medianAt(input + image.x, x, y, image.y, image.z);
+}
+#endif
+
+// Large windows, in constant time per pixel (Perreault and Hebert): every column keeps a
+// histogram of the 2 * RADIUS + 1 rows around the current one, so moving down a row
+// updates each column histogram by one pixel out and one in, and moving right along a
+// row updates the window histogram by one column histogram in and one out, whatever
+// the radius. One work-group takes a strip of rows across the whole width, with its
+// column histograms in columns (256 one-byte bins per column and channel, counts up to
+// 2 * RADIUS + 1 <= 255). Column updates are spread over the work-items by column,
+// window updates by bin; the median is then found through 16 coarse bins of 16.
+#define BINS (256 / MEDIAN_GROUP)
+
+__kernel __attribute__((reqd_work_group_size(MEDIAN_GROUP, 1, 1)))
+void median_histogram(__global const uchar4* input,
+                      __global uchar* output,
+                      __global uchar* columns,
+                      const int width,
+                      const int height,
+                      const int rows) {
+    const int lid = get_local_id(0);
+    const int y0 = get_group_id(0) * rows;
+    const int y1 = min(y0 + rows, height);
+    __global uchar* strip = columns + (size_t)get_group_id(0) * width * 768;
+
+    // Window histograms, double-buffered so one pixel's search overlaps the next one's update
+    __local int fine[2][3 * 256];
+    __local int coarse[2][3 * 16];
+
+    // Column histograms of the first row of the strip
+    for (int x = lid; x < width; x += MEDIAN_GROUP) {
+        __global uchar* column = strip + x * 768;
+        for (int i = 0; i < 768; i++) {
+            column[i] = 0;
+        }
+        for (int ky = -RADIUS; ky <= RADIUS; ky++) {
+            const uchar4 rgba = input[clamp(y0 + ky, 0, height - 1) * width + x];
+            column[rgba.x]++;
+            column[256 + rgba.y]++;
+            column[512 + rgba.z]++;
+        }
+    }
+
+    int buffer = 0;
+    for (int y = y0; y < y1; y++) {
+        if (y > y0) {
+            // The window histograms of the row above have been read from the columns
+            barrier(CLK_GLOBAL_MEM_FENCE);
+            const int leaving = clamp(y - RADIUS - 1, 0, height - 1) * width;
+            const int entering = clamp(y + RADIUS, 0, height - 1) * width;
+            for (int x = lid; x < width; x += MEDIAN_GROUP) {
+                __global uchar* column = strip + x * 768;
+                const uchar4 removed = input[leaving + x];
+                const uchar4 added = input[entering + x];
+                column[removed.x]--;
+                column[256 + removed.y]--;
+                column[512 + removed.z]--;
+                column[added.x]++;
+                column[256 + added.y]++;
+                column[512 + added.z]++;
+            }
+        }
+        barrier(CLK_GLOBAL_MEM_FENCE);
+
+        // This work-item's bins of the window at x = 0, edge columns repeated
+        int histogram[3 * BINS];
+        for (int i = 0; i < 3 * BINS; i++) {
+            histogram[i] = 0;
+        }
+        for (int kx = -RADIUS; kx <= RADIUS; kx++) {
+            __global const uchar* column = strip + clamp(kx, 0, width - 1) * 768;
+            for (int i = 0; i < 3 * BINS; i++) {
+                histogram[i] += column[(i / BINS) * 256 + i % BINS * MEDIAN_GROUP + lid];
+            }
+        }
+
+        for (int x = 0; x < width; x++) {
+            if (x > 0) {
+                __global const uchar* entering = strip + min(x + RADIUS, width - 1) * 768;
+                __global const uchar* leaving = strip + max(x - RADIUS - 1, 0) * 768;
+                for (int i = 0; i < 3 * BINS; i++) {
+                    const int bin = (i / BINS) * 256 + i % BINS * MEDIAN_GROUP + lid;
+                    histogram[i] += entering[bin] - leaving[bin];
+                }
+            }
+
+            for (int i = 0; i < 3 * BINS; i++) {
+                fine[buffer][(i / BINS) * 256 + i % BINS * MEDIAN_GROUP + lid] = histogram[i];
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+
+            for (int i = lid; i < 3 * 16; i += MEDIAN_GROUP) {
+                int sum = 0;
+                for (int k = 0; k < 16; k++) {
+                    sum += fine[buffer][i * 16 + k];
+                }
+                coarse[buffer][i] = sum;
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+
+            // median is the first value with more than WINDOW / 2 values at or below it
+            for (int c = lid; c < 3; c += MEDIAN_GROUP) {
+                int below = 0;
+                int bin = 0;
+                while (below + coarse[buffer][c * 16 + bin] <= WINDOW / 2) {
+                    below += coarse[buffer][c * 16 + bin++];
+                }
+                int median = bin * 16;
+                while (below + fine[buffer][c * 256 + median] <= WINDOW / 2) {
+                    below += fine[buffer][c * 256 + median++];
+                }
+                output[(y * width + x) * 4 + c] = median;
+                if (c == 0)
+                    output[(y * width + x) * 4 + 3] = 255;
+            }
+            buffer = 1 - buffer;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+// Two-pass resampling with per-output weight tables: output i of an axis reads taps
+// source pixels from starts[i], clamped to the edge, weighted by weights[i * taps + k].
+// The row pass keeps float4 so the image is rounded once.
+
+inline uchar4 store(float4 sum) {
+    uchar4 rgba = convert_uchar4_sat_rte(sum);
+    rgba.w = 255;
+    return rgba;
+}
+
+// width x height pixels to outWidth x height
+__kernel void resize_rows(__global const uchar4* input,
+                          __global float4* output,
+                          const int width,
+                          const int outWidth,
+                          const int height,
+                          __global const int* starts,
+                          __global const float* weights,
+                          const int taps) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= outWidth || y >= height)
+        return;
+
+    __global const uchar4* row = input + y * width;
+    __global const float* w = weights + x * taps;
+    const int start = starts[x];
+
+    float4 sum = (float4)(0.0f);
+    for (int k = 0; k < taps; k++) {
+        sum += convert_float4(row[clamp(start + k, 0, width - 1)]) * w[k];
+    }
+
+    output[y * outWidth + x] = sum;
+}
+
+// outWidth x height to outWidth x outHeight; neighbouring work-items read
+// neighbouring columns of each source row
+__kernel void resize_columns(__global const float4* input,
+                             __global uchar4* output,
+                             const int height,
+                             const int outWidth,
+                             const int outHeight,
+                             __global const int* starts,
+                             __global const float* weights,
+                             const int taps) {
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= outWidth || y >= outHeight)
+        return;
+
+    __global const float* w = weights + y * taps;
+    const int start = starts[y];
+
+    float4 sum = (float4)(0.0f);
+    for (int k = 0; k < taps; k++) {
+        sum += input[clamp(start + k, 0, height - 1) * outWidth + x] * w[k];
+    }
+
+    output[y * outWidth + x] = store(sum);
+}
@@ -1,3 +1,76 @@
+// Frame size and pixels per work-item baked in at build time with -D options,
+// otherwise the kernel arguments
+#ifdef WIDTH
+#define IMAGE_WIDTH WIDTH
+#define IMAGE_HEIGHT HEIGHT
+#define PIXEL_COUNT (WIDTH * HEIGHT)
+#else
+#define IMAGE_WIDTH width
+#define IMAGE_HEIGHT height
+#define PIXEL_COUNT pixels
+#endif
+#ifndef VECTORS
+#define VECTORS vectors
+#endif
+
+// Channel arithmetic: fp32 by default, fp16 or fixed point with FIXED_SHIFT fraction
+// bits when the program is built with PRECISION_FP16 or PRECISION_FIXED
+#if defined(PRECISION_FP16)
+#pragma OPENCL EXTENSION cl_khr_fp16 : enable
+typedef half channel;
+typedef half4 channel4;
+#define CHANNEL4(v) convert_half4(v)
+#define COEF(c) ((half)(c))
+#define ROUND(v) convert_uchar_sat_rte(v)
+#define ROUND4(v) convert_uchar4_sat_rte(v)
+#elif defined(PRECISION_FIXED)
+#define FIXED_SHIFT 14
+typedef int channel;
+typedef int4 channel4;
+#define CHANNEL4(v) convert_int4(v)
+#define COEF(c) ((int)((c) * (1 << FIXED_SHIFT) + 0.5f))
+#define ROUND(v) convert_uchar_sat(((v) + (1 << (FIXED_SHIFT - 1))) >> FIXED_SHIFT)
+#define ROUND4(v) convert_uchar4_sat(((v) + (1 << (FIXED_SHIFT - 1))) >> FIXED_SHIFT)
+#else
+typedef float channel;
+typedef float4 channel4;
+#define CHANNEL4(v) convert_float4(v)
+#define COEF(c) (c)
+#define ROUND(v) convert_uchar_sat_rte(v)
+#define ROUND4(v) convert_uchar4_sat_rte(v)
+#endif
+
+// The sepia transformation matrix is:
+// | 0.393 0.769 0.189 |
+// | 0.349 0.686 0.168 |
+// | 0.272 0.534 0.131 |
+inline uchar4 sepia(uchar4 rgba) {
+    channel r = (channel)rgba.x;
+    channel g = (channel)rgba.y;
+    channel b = (channel)rgba.z;
+
+    // Rounded to nearest and clamped to 255
+    return (uchar4)(
+        ROUND(r * COEF(0.393f) + g * COEF(0.769f) + b * COEF(0.189f)),
+        ROUND(r * COEF(0.349f) + g * COEF(0.686f) + b * COEF(0.168f)),
+        ROUND(r * COEF(0.272f) + g * COEF(0.534f) + b * COEF(0.131f)),
+        255);
+}
+
+// Four pixels at once, one vector lane per pixel
+inline uchar16 sepia4(uchar16 rgba) {
+    channel4 r = CHANNEL4(rgba.s048c);
+    channel4 g = CHANNEL4(rgba.s159d);
+    channel4 b = CHANNEL4(rgba.s26ae);
+
+    uchar4 sr = ROUND4(r * COEF(0.393f) + g * COEF(0.769f) + b * COEF(0.189f));
+    uchar4 sg = ROUND4(r * COEF(0.349f) + g * COEF(0.686f) + b * COEF(0.168f));
+    uchar4 sb = ROUND4(r * COEF(0.272f) + g * COEF(0.534f) + b * COEF(0.131f));
+
+    return (uchar16)(sr.s0, sg.s0, sb.s0, 255, sr.s1, sg.s1, sb.s1, 255,
+                     sr.s2, sg.s2, sb.s2, 255, sr.s3, sg.s3, sb.s3, 255);
+}
+
 __kernel void sepia_filter(__global const uchar4* input,
                            __global uchar4* output,
                            const int width,
@@ -5,26 +78,53 @@ __kernel void sepia_filter(__global const uchar4* input,
     const int x = get_global_id(0);
     const int y = get_global_id(1);
 
-    if (x >= width || y >= height) 
+    if (x >= IMAGE_WIDTH || y >= IMAGE_HEIGHT) 
         return;
 
-    const int idx = (y * width + x);
-
-    uchar4 rgba = input[idx];
-    // Apply sepia transformation
-    // The sepia transformation matrix is:
-    // | 0.393 0.769 0.189 |
-    // | 0.349 0.686 0.168 |
-    // | 0.272 0.534 0.131 |
-    float r = dot(convert_float3(rgba.xyz), (float3)(0.393f, 0.769f, 0.189f));
-    float g = dot(convert_float3(rgba.xyz), (float3)(0.349f, 0.686f, 0.168f));
-    float b = dot(convert_float3(rgba.xyz), (float3)(0.272f, 0.534f, 0.131f));
-   
-    // Clamp to 255
-    output[idx] = (uchar4)(
-        fmin(r, 255.0f),
-        fmin(g, 255.0f),
-        fmin(b, 255.0f),
-        255);
+    const int idx = (y * IMAGE_WIDTH + x);
+
+    output[idx] = sepia(input[idx]);
+}
 
+// Several images packed back to back in one buffer. Each entry of images holds
+// (pixel offset, width, height, unused); the third launch dimension selects the entry.
+__kernel void sepia_filter_batched(__global const uchar4* input,
+                                   __global uchar4* output,
+                                   __global const int4* images) {
+    const int4 image = images[get_global_id(2)];
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+
+    if (x >= image.y || y >= image.z)
+        return;
+
+    const int idx = image.x + y * image.y + x;
+
+    output[idx] = sepia(input[idx]);
+}
+
+// Flat 1D variant for wide SIMD devices: each work-item converts `vectors` groups of
+// four pixels with vload16/vstore16, and the last one finishes the pixels that do not
+// fill a group one at a time.
+__kernel void sepia_filter_vec(__global const uchar4* input,
+                               __global uchar4* output,
+                               const int pixels,
+                               const int vectors) {
+    __global const uchar* src = (__global const uchar*)input;
+    __global uchar* dst = (__global uchar*)output;
+    const int base = get_global_id(0) * VECTORS * 4;
+
+    for (int v = 0; v < VECTORS; v++) {
+        const int p = base + v * 4;
+
+        if (p + 4 <= PIXEL_COUNT) {
+            vstore16(sepia4(vload16(0, src + p * 4)), 0, dst + p * 4);
+            continue;
+        }
+
+        for (int i = p; i < PIXEL_COUNT; i++) {
+            output[i] = sepia(input[i]);
+        }
+        return;
+    }
 }
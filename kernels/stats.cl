@@ -0,0 +1,76 @@
+// Per-channel sum, sum of squares, minimum and maximum of an image, as a tree
+// reduction: stats_reduce leaves one partial result per work-group, stats_merge
+// combines those in a single work-group. Built with -DSTATS_GROUP, the work-group
+// size of both, a power of two.
+#ifndef STATS_GROUP
+#define STATS_GROUP 256
+#endif
+
+typedef struct {
+    ulong4 sum;
+    ulong4 squares;
+    uint4 min;
+    uint4 max;
+} Partial;
+
+// Halves the live part of partials each step until partials[0] holds the group's result
+inline void reduceGroup(__local Partial* partials) {
+    const int lid = get_local_id(0);
+
+    for (int stride = STATS_GROUP / 2; stride > 0; stride >>= 1) {
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (lid < stride) {
+            __local Partial* a = &partials[lid];
+            __local const Partial* b = &partials[lid + stride];
+            a->sum += b->sum;
+            a->squares += b->squares;
+            a->min = min(a->min, b->min);
+            a->max = max(a->max, b->max);
+        }
+    }
+}
+
+// Each work-item first folds a strided share of the pixels in registers
+__kernel __attribute__((reqd_work_group_size(STATS_GROUP, 1, 1)))
+void stats_reduce(__global const uchar4* input,
+                  __global Partial* results,
+                  const int pixels) {
+    __local Partial partials[STATS_GROUP];
+    Partial own = {(ulong4)(0), (ulong4)(0), (uint4)(255), (uint4)(0)};
+
+    for (int i = get_global_id(0); i < pixels; i += get_global_size(0)) {
+        const uint4 rgba = convert_uint4(input[i]);
+        own.sum += convert_ulong4(rgba);
+        own.squares += convert_ulong4(rgba * rgba);
+        own.min = min(own.min, rgba);
+        own.max = max(own.max, rgba);
+    }
+
+    partials[get_local_id(0)] = own;
+    reduceGroup(partials);
+
+    if (get_local_id(0) == 0)
+        results[get_group_id(0)] = partials[0];
+}
+
+// Final pass over the count partial results, in place into results[0]
+__kernel __attribute__((reqd_work_group_size(STATS_GROUP, 1, 1)))
+void stats_merge(__global Partial* results,
+                 const int count) {
+    __local Partial partials[STATS_GROUP];
+    Partial own = {(ulong4)(0), (ulong4)(0), (uint4)(255), (uint4)(0)};
+
+    for (int i = get_local_id(0); i < count; i += STATS_GROUP) {
+        const Partial other = results[i];
+        own.sum += other.sum;
+        own.squares += other.squares;
+        own.min = min(own.min, other.min);
+        own.max = max(own.max, other.max);
+    }
+
+    partials[get_local_id(0)] = own;
+    reduceGroup(partials);
+
+    if (get_local_id(0) == 0)
+        results[0] = partials[0];
+}
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "engine.h"
+
+// Timings of the algorithm choices pixcl makes, on the first GPU and a random
+// image: adaptive threshold and box blur through a summed-area table against summing
+// every window directly, and direct against FFT convolution, which gives the crossover
+// to pass to --fft-crossover. Run from the repository root, where the kernels are.
+namespace {
+
+constexpr int REPEATS = 5;
+
+// Best of REPEATS runs after a warm-up that builds the kernels, in milliseconds
+template<typename Run>
+double measure(Run&& run) {
+    run();
+
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < REPEATS; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                                  .count());
+    }
+    return best;
+}
+
+// processBatch runs adaptive_threshold_batched and box_blur_batched, which sum each window directly
+void benchWindows(Engine& engine, const PixelBuffer& src, const PixelBuffer& dst) {
+    std::cout << "thr, box: summed-area table vs direct window sums\n"
+              << std::format("{:>8} {:>8} {:>12} {:>12} {:>9}\n", "effect", "radius", "table ms", "direct ms",
+                             "speedup");
+
+    constexpr std::pair<Effect, const char*> effects[] = {{Effect::ADAPTIVE_THRESHOLD, "thr"},
+                                                          {Effect::BOX_BLUR, "box"}};
+    for (const auto& [effect, name] : effects) {
+        for (const int radius : {1, 3, 7, 15, 31, 63}) {
+            engine.setThreshold(radius, 0.15f);
+            engine.setBoxRadius(radius);
+            const double table = measure([&] { engine.process(effect, src, dst); });
+            const double direct = measure([&] {
+                engine.processBatch(std::span(&effect, 1), std::span(&src, 1), std::span(&dst, 1));
+            });
+            std::cout << std::format("{:>8} {:>8} {:>12.3f} {:>12.3f} {:>8.1f}x\n", name, radius, table, direct,
+                                     direct / table);
+        }
+    }
+
+    // box and thr of one image through processEach build the table once
+    const Effect both[] = {Effect::BOX_BLUR, Effect::ADAPTIVE_THRESHOLD};
+    const PixelBuffer dsts[] = {dst, dst};
+    engine.setThreshold(15, 0.15f);
+    engine.setBoxRadius(15);
+    const double separate = measure([&] {
+        engine.process(both[0], src, dst);
+        engine.process(both[1], src, dst);
+    });
+    const double shared = measure([&] { engine.processEach(both, src, dsts); });
+    std::cout << std::format("box + thr, radius 15: {:.3f} ms separately, {:.3f} ms sharing the table\n", separate,
+                             shared);
+}
+
+void benchConvolution(Engine& engine, const PixelBuffer& src, const PixelBuffer& dst, std::mt19937& random) {
+    std::cout << "\nconv: direct vs FFT\n"
+              << std::format("{:>8} {:>12} {:>12}\n", "matrix", "direct ms", "fft ms");
+
+    const Effect effect = Effect::CONVOLVE;
+    size_t crossover = 0;
+    bool fftWon = false;
+    for (const int side : {3, 9, 15, 21, 31, 45, 63}) {
+        // Random weights are not separable, so the direct path is the one-pass kernel
+        std::uniform_real_distribution<float> weight(0.0f, 2.0f / (side * side));
+        std::vector<float> weights(static_cast<size_t>(side) * side);
+        for (float& w : weights) {
+            w = weight(random);
+        }
+        engine.setConvolution(Convolution(side, side, std::move(weights)));
+
+        engine.setFftCrossover(std::numeric_limits<size_t>::max());
+        const double direct = measure([&] { engine.process(effect, src, dst); });
+        engine.setFftCrossover(0);
+        const double fft = measure([&] { engine.process(effect, src, dst); });
+        std::cout << std::format("{:>4}x{:<3} {:>12.3f} {:>12.3f}\n", side, side, direct, fft);
+
+        fftWon = fftWon || fft < direct;
+        if (!fftWon) crossover = static_cast<size_t>(side) * side;
+    }
+    std::cout << std::format("crossover: --fft-crossover {}\n", crossover);
+}
+}
+
+int main(int argc, char** argv) {
+    try {
+        const int width = argc > 2 ? static_cast<int>(strtol(argv[1], nullptr, 10)) : 2048;
+        const int height = argc > 2 ? static_cast<int>(strtol(argv[2], nullptr, 10)) : 2048;
+        if (width <= 0 || height <= 0) {
+            throw std::runtime_error("USAGE: pixcl-bench [width height]");
+        }
+
+        std::mt19937 random(1);
+        std::vector<uint8_t> input(static_cast<size_t>(width) * height * 4);
+        std::vector<uint8_t> output(input.size());
+        for (uint8_t& value : input) {
+            value = static_cast<uint8_t>(random());
+        }
+        const PixelBuffer src{input.data(), width, height, 0, PixelFormat::RGBA8};
+        const PixelBuffer dst{output.data(), width, height, 0, PixelFormat::RGBA8};
+
+        Engine engine;
+        std::cout << std::format("{}x{} RGBA, best of {} runs including transfers\n\n", width, height, REPEATS);
+        benchWindows(engine, src, dst);
+        benchConvolution(engine, src, dst, random);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
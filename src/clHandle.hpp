@@ -0,0 +1,61 @@
+#ifndef CLHANDLE_HPP
+#define CLHANDLE_HPP
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <utility>
+
+// Move-only owner of an OpenCL object; releases it when destroyed or replaced.
+template<typename T, auto Release>
+class CLHandle {
+public:
+    CLHandle() = default;
+
+    explicit CLHandle(T handle) : mHandle(handle) {}
+
+    ~CLHandle() { reset(); }
+
+    CLHandle(const CLHandle&) = delete;
+
+    CLHandle& operator=(const CLHandle&) = delete;
+
+    CLHandle(CLHandle&& other) noexcept : mHandle(std::exchange(other.mHandle, nullptr)) {}
+
+    CLHandle& operator=(CLHandle&& other) noexcept {
+        if (this != &other) {
+            reset(std::exchange(other.mHandle, nullptr));
+        }
+        return *this;
+    }
+
+    [[nodiscard]] T get() const { return mHandle; }
+
+    // Releases the current object and exposes the slot to APIs that return
+    // handles through an out parameter, such as the event of an enqueue call
+    T* out() {
+        reset();
+        return &mHandle;
+    }
+
+    void reset(T handle = nullptr) {
+        if (mHandle != nullptr) Release(mHandle);
+        mHandle = handle;
+    }
+
+    explicit operator bool() const { return mHandle != nullptr; }
+
+private:
+    T mHandle{nullptr};
+};
+
+using CLContext = CLHandle<cl_context, clReleaseContext>;
+using CLQueue = CLHandle<cl_command_queue, clReleaseCommandQueue>;
+using CLProgram = CLHandle<cl_program, clReleaseProgram>;
+using CLKernel = CLHandle<cl_kernel, clReleaseKernel>;
+using CLMem = CLHandle<cl_mem, clReleaseMemObject>;
+using CLEvent = CLHandle<cl_event, clReleaseEvent>;
+
+#endif //CLHANDLE_HPP
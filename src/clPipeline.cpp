@@ -1,56 +1,111 @@
 #include "clPipeline.h"
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <format>
 #include <stdexcept>
+#include <vector>
 #include "io.hpp"
 #include "clError.hpp"
 
-CLPipeline::CLPipeline() {
+CLPipeline::CLPipeline(const DeviceType type) {
     // Get Platform and Device Info
-    err = clGetPlatformIDs(1, &platform, &platformCount);
+    err = clGetPlatformIDs(0, nullptr, &platformCount);
+    checkError(err, "Failed to get platform IDs");
+    std::vector<cl_platform_id> platforms(platformCount);
+    err = clGetPlatformIDs(platformCount, platforms.data(), nullptr);
     checkError(err, "Failed to get platform IDs");
 
-    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device, &deviceCount);
+    // CPU devices often come from a platform of their own, e.g. PoCL next to a GPU driver
+    const cl_device_type deviceType = type == DeviceType::CPU ? CL_DEVICE_TYPE_CPU : CL_DEVICE_TYPE_GPU;
+    err = CL_DEVICE_NOT_FOUND;
+    for (const cl_platform_id candidate : platforms) {
+        if (clGetDeviceIDs(candidate, deviceType, 1, &device, &deviceCount) == CL_SUCCESS) {
+            platform = candidate;
+            err = CL_SUCCESS;
+            break;
+        }
+    }
     checkError(err, "Failed to get device IDs");
 
+    size_t extensionsSize = 0;
+    clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, 0, nullptr, &extensionsSize);
+    extensions.resize(extensionsSize);
+    clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, extensionsSize, extensions.data(), nullptr);
+
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(maxGroupSize), &maxGroupSize, nullptr);
+    clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(localMemBytes), &localMemBytes, nullptr);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(maxAllocBytes), &maxAllocBytes, nullptr);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE, sizeof(maxConstantBytes), &maxConstantBytes,
+                    nullptr);
+    clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR, sizeof(charVectorWidth), &charVectorWidth,
+                    nullptr);
+    clGetDeviceInfo(device, CL_DEVICE_IMAGE_SUPPORT, sizeof(imageSupport), &imageSupport, nullptr);
+    if (imageSupport) {
+        clGetDeviceInfo(device, CL_DEVICE_IMAGE2D_MAX_WIDTH, sizeof(maxImageWidth), &maxImageWidth, nullptr);
+        clGetDeviceInfo(device, CL_DEVICE_IMAGE2D_MAX_HEIGHT, sizeof(maxImageHeight), &maxImageHeight, nullptr);
+    }
+
     // Create OpenCL context
-    context = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &err);
+    context.reset(clCreateContext(nullptr, 1, &device, nullptr, nullptr, &err));
     checkError(err, "Failed to create the context");
 
     // Create Command Queue
-    queue = clCreateCommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE, &err);
+    queue.reset(clCreateCommandQueue(context.get(), device, CL_QUEUE_PROFILING_ENABLE, &err));
     checkError(err, "Failed to create the command queue");
+
+    transferQueue.reset(clCreateCommandQueue(context.get(), device, 0, &err));
+    checkError(err, "Failed to create the transfer queue");
 }
 
-CLPipeline::~CLPipeline() {
-    clReleaseEvent(readEvent);
-    clReleaseEvent(writeEvent);
-    clReleaseEvent(kernelEvent);
-    clReleaseKernel(kernel);
-    clReleaseProgram(program);
-    clReleaseMemObject(inputBuffer);
-    clReleaseMemObject(outputBuffer);
-    clReleaseMemObject(kernelBuffer);
-    clReleaseCommandQueue(queue);
-    clReleaseContext(context);
+DeviceType CLPipeline::getDeviceType(const char* name) {
+    if (!std::strcmp(name, "gpu")) return DeviceType::GPU;
+    if (!std::strcmp(name, "cpu")) return DeviceType::CPU;
+
+    throw std::runtime_error("Unknown Device: " + std::string(name));
 }
 
-void CLPipeline::execute(const int width, const int height) {
+void CLPipeline::execute(const int width, const int height, size_t localSide) {
     // Set the work item size
-    size_t maxGroupSize;
-    clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &maxGroupSize, nullptr);
-
-    const auto side = static_cast<size_t>(sqrt(maxGroupSize));
-    const size_t localWorkSize[2] = {side, side};
+    if (localSide == 0) {
+        size_t kernelGroupSize;
+        clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &kernelGroupSize,
+                                 nullptr);
+        localSide = static_cast<size_t>(sqrt(kernelGroupSize));
+    }
+    const size_t localWorkSize[2] = {localSide, localSide};
 
     const size_t globalWorkSize[2] = {
         ((width + localWorkSize[0] - 1) / localWorkSize[0]) * localWorkSize[0],
         ((height + localWorkSize[1] - 1) / localWorkSize[1]) * localWorkSize[1]
     };
     // Execute Kernel
-    err = clEnqueueNDRangeKernel(queue, kernel, 2, nullptr, globalWorkSize, localWorkSize, 0, nullptr,
-                                 &kernelEvent);
+    err = clEnqueueNDRangeKernel(queue.get(), kernel, 2, nullptr, globalWorkSize, localWorkSize, 0, nullptr,
+                                 kernelEvent.out());
+    checkError(err, "Failed to execute the kernel");
+}
+
+void CLPipeline::executeLinear(const size_t count, const size_t localSize) {
+    err = clEnqueueNDRangeKernel(queue.get(), kernel, 1, nullptr, &count, localSize ? &localSize : nullptr, 0, nullptr,
+                                 kernelEvent.out());
+    checkError(err, "Failed to execute the kernel");
+}
+
+void CLPipeline::executeBatch(const int width, const int height, const int count) {
+    size_t kernelGroupSize;
+    clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &kernelGroupSize, nullptr);
+
+    const auto side = static_cast<size_t>(sqrt(kernelGroupSize));
+    const size_t localWorkSize[3] = {side, side, 1};
+
+    const size_t globalWorkSize[3] = {
+        ((width + localWorkSize[0] - 1) / localWorkSize[0]) * localWorkSize[0],
+        ((height + localWorkSize[1] - 1) / localWorkSize[1]) * localWorkSize[1],
+        static_cast<size_t>(count)
+    };
+
+    err = clEnqueueNDRangeKernel(queue.get(), kernel, 3, nullptr, globalWorkSize, localWorkSize, 0, nullptr,
+                                 kernelEvent.out());
     checkError(err, "Failed to execute the kernel");
 }
 
@@ -58,44 +113,142 @@ cl_mem CLPipeline::createBuffer(const BufferType type, const int width, const in
                                 void* ptr) {
     switch (type) {
         case BufferType::INPUT:
-            inputBuffer = clCreateBuffer(context, flags, width * height * sizeof(cl_uchar4), ptr, &err);
-            return inputBuffer;
+            inputBuffer = createBuffer(width * height * sizeof(cl_uchar4), flags, ptr);
+            return inputBuffer.get();
         case BufferType::OUTPUT:
-            outputBuffer = clCreateBuffer(context, flags, width * height * sizeof(cl_uchar4), ptr, &err);
-            return outputBuffer;
+            outputBuffer = createBuffer(width * height * sizeof(cl_uchar4), flags, ptr);
+            return outputBuffer.get();
         case BufferType::KERNEL:
-            kernelBuffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(gaussianKernel),
-                                          (void*) gaussianKernel, &err);
-            return kernelBuffer;
+            kernelBuffer = createBuffer(sizeof(gaussianKernel), CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                        (void*) gaussianKernel);
+            return kernelBuffer.get();
     }
 
     return nullptr;
 }
 
+CLMem CLPipeline::createBuffer(const size_t size, const cl_mem_flags flags, void* ptr) {
+    cl_int status;
+    CLMem buffer(clCreateBuffer(context.get(), flags, size, ptr, &status));
+    checkError(status, "Failed to create the buffer");
+    return buffer;
+}
+
 void CLPipeline::writeBuffer(cl_mem buffer, const void* data, const int width, const int height, const int channels,
                              const size_t offset) {
     // Transfer data to GPU
-    err = clEnqueueWriteBuffer(queue, buffer, CL_FALSE, offset, width * height * channels * sizeof(cl_uchar), data,
-                               0, nullptr, &writeEvent);
+    err = clEnqueueWriteBuffer(queue.get(), buffer, CL_FALSE, offset, width * height * channels * sizeof(cl_uchar),
+                               data, 0, nullptr, writeEvent.out());
     checkError(err, "Failed to write data to the buffer");
 }
 
 void CLPipeline::readBuffer(cl_mem buffer, void* data, const int width, const int height, const size_t offset) {
-    err = clEnqueueReadBuffer(queue, buffer, CL_FALSE, offset, width * height * sizeof(cl_uchar4), data,
-                              1, &kernelEvent, &readEvent);
+    const cl_event kernelDone = kernelEvent.get();
+    err = clEnqueueReadBuffer(queue.get(), buffer, CL_FALSE, offset, width * height * sizeof(cl_uchar4), data,
+                              kernelDone ? 1 : 0, kernelDone ? &kernelDone : nullptr, readEvent.out());
     checkError(err, "Failed to read data from the buffer");
     // Wait for the reading buffer to finish
-    clWaitForEvents(1, &readEvent);
+    const cl_event readDone = readEvent.get();
+    clWaitForEvents(1, &readDone);
+}
+
+void CLPipeline::readBytes(cl_mem buffer, void* data, const size_t size, const size_t offset) {
+    const cl_event kernelDone = kernelEvent.get();
+    err = clEnqueueReadBuffer(queue.get(), buffer, CL_FALSE, offset, size, data, kernelDone ? 1 : 0,
+                              kernelDone ? &kernelDone : nullptr, readEvent.out());
+    checkError(err, "Failed to read data from the buffer");
+    const cl_event readDone = readEvent.get();
+    clWaitForEvents(1, &readDone);
 }
 
-void CLPipeline::createProgram(const char* kernelName) {
+void CLPipeline::writeBytes(cl_mem buffer, const void* data, const size_t size, const size_t offset) {
+    err = clEnqueueWriteBuffer(queue.get(), buffer, CL_FALSE, offset, size, data, 0, nullptr, writeEvent.out());
+    checkError(err, "Failed to write data to the buffer");
+}
+
+CLMem CLPipeline::createImage(const int width, const int height, const cl_mem_flags flags) {
+    const cl_image_format format{CL_RGBA, CL_UNORM_INT8};
+    cl_image_desc desc{};
+    desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+    desc.image_width = width;
+    desc.image_height = height;
+
+    cl_int status;
+    CLMem image(clCreateImage(context.get(), flags, &format, &desc, nullptr, &status));
+    checkError(status, "Failed to create the image");
+    return image;
+}
+
+void CLPipeline::copyToImage(cl_mem buffer, cl_mem image, const int width, const int height) {
+    const size_t origin[3] = {0, 0, 0};
+    const size_t region[3] = {static_cast<size_t>(width), static_cast<size_t>(height), 1};
+    err = clEnqueueCopyBufferToImage(queue.get(), buffer, image, 0, origin, region, 0, nullptr, nullptr);
+    checkError(err, "Failed to copy the buffer to the image");
+}
+
+std::string CLPipeline::deviceDescription() const {
+    auto info = [this](const cl_device_info param) {
+        size_t size = 0;
+        clGetDeviceInfo(device, param, 0, nullptr, &size);
+        std::string value(size, '\0');
+        clGetDeviceInfo(device, param, size, value.data(), nullptr);
+        // Drop the terminator the size includes
+        value.resize(value.find('\0'));
+        return value;
+    };
+
+    return info(CL_DEVICE_NAME) + " " + info(CL_DRIVER_VERSION);
+}
+
+void CLPipeline::finish() {
+    err = clFinish(queue.get());
+    checkError(err, "Failed to finish the queue");
+}
+
+bool CLPipeline::hasExtension(const char* name) const {
+    // Space separated list; match whole names only
+    const std::string padded = " " + std::string(extensions.c_str()) + " ";
+    return padded.find(" " + std::string(name) + " ") != std::string::npos;
+}
+
+bool CLPipeline::supportsImage(const int width, const int height) const {
+    return imageSupport && static_cast<size_t>(width) <= maxImageWidth &&
+           static_cast<size_t>(height) <= maxImageHeight;
+}
+
+void* CLPipeline::mapBuffer(cl_mem buffer, const size_t size, const cl_map_flags flags) {
+    cl_int status;
+    void* ptr = clEnqueueMapBuffer(transferQueue.get(), buffer, CL_TRUE, flags, 0, size, 0, nullptr, nullptr,
+                                   &status);
+    checkError(status, "Failed to map the buffer");
+    return ptr;
+}
+
+void CLPipeline::unmapBuffer(cl_mem buffer, void* ptr) {
+    CLEvent unmapped;
+    const cl_int status = clEnqueueUnmapMemObject(transferQueue.get(), buffer, ptr, 0, nullptr, unmapped.out());
+    checkError(status, "Failed to unmap the buffer");
+    // Kernels on the main queue may use the buffer right after this returns
+    const cl_event done = unmapped.get();
+    clWaitForEvents(1, &done);
+}
+
+void CLPipeline::createProgram(const char* kernelName, const std::string& options) {
+    programKey = std::string(kernelName) + options;
+    if (const auto it = programs.find(programKey); it != programs.end()) {
+        program = it->second.get();
+        return;
+    }
+
     const std::string source = loadKernelSource(fs::path(std::string("kernels/") + kernelName + ".cl").c_str());
     const char* source_str = source.c_str();
     const size_t source_size = source.size();
 
-    program = clCreateProgramWithSource(context, 1, &source_str, &source_size, &err);
+    program = clCreateProgramWithSource(context.get(), 1, &source_str, &source_size, &err);
+    checkError(err, "Failed to create the program");
+    programs.emplace(programKey, CLProgram(program));
 
-    err = clBuildProgram(program, 0, nullptr, nullptr, nullptr, nullptr);
+    err = clBuildProgram(program, 0, nullptr, options.c_str(), nullptr, nullptr);
     if (err != CL_SUCCESS) {
         // Determine the size of the log
         size_t log_size;
@@ -111,19 +264,26 @@ void CLPipeline::createProgram(const char* kernelName) {
 }
 
 void CLPipeline::createKernel(const char* kernelName) {
+    const std::string key = programKey + "/" + kernelName;
+    if (const auto it = kernels.find(key); it != kernels.end()) {
+        kernel = it->second.get();
+        return;
+    }
+
     kernel = clCreateKernel(program, kernelName, &err);
     checkError(err, "Failed to create the kernel");
+    kernels.emplace(key, CLKernel(kernel));
 }
 
 void CLPipeline::printProfilingInfo() const {
     // Get profiling information
     cl_ulong start, end;
-    clGetEventProfilingInfo(kernelEvent, CL_PROFILING_COMMAND_START, sizeof(start), &start, nullptr);
-    clGetEventProfilingInfo(kernelEvent, CL_PROFILING_COMMAND_END, sizeof(end), &end, nullptr);
+    clGetEventProfilingInfo(kernelEvent.get(), CL_PROFILING_COMMAND_START, sizeof(start), &start, nullptr);
+    clGetEventProfilingInfo(kernelEvent.get(), CL_PROFILING_COMMAND_END, sizeof(end), &end, nullptr);
     std::cout << "Kernel Execution Time: " << static_cast<double>(end - start) / 1000.0 << " ms" << std::endl;
 
-    clGetEventProfilingInfo(readEvent, CL_PROFILING_COMMAND_START, sizeof(start), &start, nullptr);
-    clGetEventProfilingInfo(readEvent, CL_PROFILING_COMMAND_END, sizeof(end), &end, nullptr);
+    clGetEventProfilingInfo(readEvent.get(), CL_PROFILING_COMMAND_START, sizeof(start), &start, nullptr);
+    clGetEventProfilingInfo(readEvent.get(), CL_PROFILING_COMMAND_END, sizeof(end), &end, nullptr);
     std::cout << "Data Read Time: " << static_cast<double>(end - start) / 1000.0 << " ms" << std::endl;
 }
 
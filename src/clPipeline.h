@@ -6,35 +6,114 @@
 #else
 #include <CL/cl.h>
 #endif
+#include <format>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
+#include "clHandle.hpp"
 
 enum class BufferType {
     INPUT, OUTPUT, KERNEL
 };
 
+enum class DeviceType {
+    GPU, CPU
+};
+
 class CLPipeline {
 public:
-    CLPipeline();
+    // Opens the first device of the type on any platform
+    explicit CLPipeline(DeviceType type = DeviceType::GPU);
+
+    static DeviceType getDeviceType(const char* name);
 
-    ~CLPipeline();
+    // 2D launch; localSide 0 derives the work-group side from the kernel's limit
+    void execute(int width, int height, size_t localSide = 0);
 
-    void execute(int width, int height);
+    // 1D launch of count work-items; localSize 0 lets the driver pick the work-group size,
+    // otherwise count must be a multiple of it
+    void executeLinear(size_t count, size_t localSize = 0);
 
+    // 3D launch over count packed images no larger than width x height
+    void executeBatch(int width, int height, int count);
+
+    // Buffers owned by the pipeline; creating one again replaces the previous buffer of that type
     cl_mem createBuffer(BufferType type, int width = 0, int height = 0, cl_mem_flags flags = 0, void* ptr = nullptr);
 
+    // Buffer owned by the caller
+    CLMem createBuffer(size_t size, cl_mem_flags flags, void* ptr = nullptr);
+
     void writeBuffer(cl_mem buffer, const void* data, int width, int height, int channels, size_t offset = 0);
 
     void readBuffer(cl_mem buffer, void* data, int width, int height, size_t offset = 0);
 
-    void createProgram(const char* kernelName);
+    void writeBytes(cl_mem buffer, const void* data, size_t size, size_t offset = 0);
+
+    // Blocking read of size bytes, after the kernels enqueued so far
+    void readBytes(cl_mem buffer, void* data, size_t size, size_t offset = 0);
+
+    // RGBA/UNORM_INT8 image, read through samplers by the *_image kernels
+    CLMem createImage(int width, int height, cl_mem_flags flags);
+
+    // Device-side copy of packed RGBA pixels into an image of the same size
+    void copyToImage(cl_mem buffer, cl_mem image, int width, int height);
+
+    [[nodiscard]] size_t maxWorkGroupSize() const { return maxGroupSize; }
+
+    [[nodiscard]] cl_ulong localMemSize() const { return localMemBytes; }
+
+    [[nodiscard]] cl_ulong maxConstantSize() const { return maxConstantBytes; }
+
+    [[nodiscard]] cl_ulong maxAllocSize() const { return maxAllocBytes; }
+
+    // Device name and driver version, to key measurements made on this device
+    [[nodiscard]] std::string deviceDescription() const;
+
+    // Blocks until every command enqueued so far has completed
+    void finish();
+
+    // Whether CL_DEVICE_EXTENSIONS lists the extension
+    [[nodiscard]] bool hasExtension(const char* name) const;
+
+    // CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR: SIMD width in bytes the device wants kernels to use
+    [[nodiscard]] cl_uint preferredCharWidth() const { return charVectorWidth; }
+
+    // False without CL_DEVICE_IMAGE_SUPPORT or when the size exceeds the device's image limits
+    [[nodiscard]] bool supportsImage(int width, int height) const;
+
+    // Blocking map/unmap on a queue of their own, so host threads can fill buffers
+    // while kernels run. Together with the owned createBuffer these are safe to call
+    // from other threads.
+    void* mapBuffer(cl_mem buffer, size_t size, cl_map_flags flags);
+
+    void unmapBuffer(cl_mem buffer, void* ptr);
 
+    // Builds the program once per name and build options; later calls with the same
+    // pair reuse it. Options specialise a program, e.g. define("RADIUS", 2).
+    void createProgram(const char* kernelName, const std::string& options = {});
+
+    // Creates the kernel of the current program once and makes it the target of setKernelArgs/execute
     void createKernel(const char* kernelName);
 
+    // " -DNAME=value", to be appended to createProgram options
+    template<typename T>
+    static std::string define(const char* name, const T& value) { return std::format(" -D{}={}", name, value); }
+
     template<typename... Args>
     void setKernelArgs(Args&&... args);
 
     void printProfilingInfo() const;
 
+    // 5x5 Gaussian, sigma ~1
+    static constexpr int gaussianRadius = 2;
+    static constexpr float gaussianKernel[25] = {
+        0.003765, 0.015019, 0.023792, 0.015019, 0.003765,
+        0.015019, 0.059912, 0.094907, 0.059912, 0.015019,
+        0.023792, 0.094907, 0.150342, 0.094907, 0.023792,
+        0.015019, 0.059912, 0.094907, 0.059912, 0.015019,
+        0.003765, 0.015019, 0.023792, 0.015019, 0.003765
+    };
+
 private:
     std::string loadKernelSource(const char* filename);
 
@@ -44,26 +123,32 @@ private:
     cl_int err{0};
     cl_device_id device{nullptr};
     cl_platform_id platform{nullptr};
-    cl_context context{nullptr};
-    cl_command_queue queue{nullptr};
+    CLContext context;
+    CLQueue queue;
+    CLQueue transferQueue;
     cl_program program{nullptr};
+    // Cache key of program, kernels are cached per program
+    std::string programKey;
     cl_kernel kernel{nullptr};
-    cl_event readEvent{nullptr};
-    cl_event writeEvent{nullptr};
-    cl_event kernelEvent{nullptr};
+    std::unordered_map<std::string, CLProgram> programs;
+    std::unordered_map<std::string, CLKernel> kernels;
+    CLEvent readEvent;
+    CLEvent writeEvent;
+    CLEvent kernelEvent;
+    size_t maxGroupSize{1};
+    cl_ulong localMemBytes{0};
+    cl_ulong maxConstantBytes{0};
+    cl_ulong maxAllocBytes{0};
+    std::string extensions;
+    cl_uint charVectorWidth{1};
+    cl_bool imageSupport{CL_FALSE};
+    size_t maxImageWidth{0};
+    size_t maxImageHeight{0};
     cl_uint platformCount{0};
     cl_uint deviceCount{0};
-    cl_mem inputBuffer{nullptr};
-    cl_mem outputBuffer{nullptr};
-    cl_mem kernelBuffer{nullptr};
-
-    static constexpr float gaussianKernel[25] = {
-        0.003765, 0.015019, 0.023792, 0.015019, 0.003765,
-        0.015019, 0.059912, 0.094907, 0.059912, 0.015019,
-        0.023792, 0.094907, 0.150342, 0.094907, 0.023792,
-        0.015019, 0.059912, 0.094907, 0.059912, 0.015019,
-        0.003765, 0.015019, 0.023792, 0.015019, 0.003765
-    };
+    CLMem inputBuffer;
+    CLMem outputBuffer;
+    CLMem kernelBuffer;
 };
 
 template<typename... Args>
@@ -72,7 +157,13 @@ void CLPipeline::setKernelArgs(Args&&... args) {
 
     auto applyArg = [&](auto&& arg) {
         using T = std::decay_t<decltype(arg)>;
-        clSetKernelArg(kernel, index++, sizeof(T), &arg);
+        if constexpr (requires { arg.get(); }) {
+            // Owning handles pass the object they hold
+            const auto handle = arg.get();
+            clSetKernelArg(kernel, index++, sizeof(handle), &handle);
+        } else {
+            clSetKernelArg(kernel, index++, sizeof(T), &arg);
+        }
     };
 
     (applyArg(std::forward<Args>(args)), ...);
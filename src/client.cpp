@@ -0,0 +1,98 @@
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "protocol.hpp"
+
+// Closes the connection on every path out of main, including a failed connect
+struct Socket {
+    int fd;
+    ~Socket() {
+        if (fd >= 0) ::close(fd);
+    }
+};
+
+// Minimal client for `pixcl --serve`. Sends the image inline and writes the
+// encoded result locally, so it can be used without any external tooling.
+int main(int argc, char** argv) {
+    static const char* usage = "USAGE: pixcl-client <socket> -e <effect[,effect...]> -f <format [quality]> "
+            "-o <outfile> <image file>\n";
+
+    const char* socketPath = nullptr;
+    const char* effect = nullptr;
+    const char* image = nullptr;
+    const char* outfile = nullptr;
+    std::string format;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "-e") && i + 1 < argc) {
+            effect = argv[++i];
+        } else if (!std::strcmp(argv[i], "-f") && i + 1 < argc) {
+            format = argv[++i];
+            // Optional jpg quality
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+                format += std::string(" ") + argv[++i];
+            }
+        } else if (!std::strcmp(argv[i], "-o") && i + 1 < argc) {
+            outfile = argv[++i];
+        } else if (socketPath == nullptr) {
+            socketPath = argv[i];
+        } else {
+            image = argv[i];
+        }
+    }
+
+    if (socketPath == nullptr || effect == nullptr || format.empty() || outfile == nullptr || image == nullptr) {
+        std::cerr << usage;
+        return 1;
+    }
+
+    try {
+        std::ifstream file(image, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open " + std::string(image));
+        }
+        const std::string bytes((std::istreambuf_iterator(file)), std::istreambuf_iterator<char>());
+
+        const Socket socket{::socket(AF_UNIX, SOCK_STREAM, 0)};
+        const int fd = socket.fd;
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            throw std::runtime_error("Could not connect to " + std::string(socketPath));
+        }
+
+        protocol::writeFrame(fd, effect);
+        protocol::writeFrame(fd, format);
+        protocol::writeFrame(fd, "data");
+        protocol::writeFrame(fd, bytes);
+        protocol::writeFrame(fd, "");
+
+        std::string status, payload;
+        if (!protocol::readFrame(fd, status) || !protocol::readFrame(fd, payload)) {
+            throw std::runtime_error("Connection closed by the server");
+        }
+
+        if (status != "ok") {
+            throw std::runtime_error(payload);
+        }
+
+        std::ofstream out(outfile, std::ios::binary);
+        out.write(payload.data(), static_cast<long>(payload.size()));
+        if (!out) {
+            throw std::runtime_error("Could not write " + std::string(outfile));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
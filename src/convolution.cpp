@@ -0,0 +1,149 @@
+#include "convolution.h"
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+Convolution::Convolution(const int width, const int height, std::vector<float> weights)
+    : mWidth(width), mHeight(height), mWeights(std::move(weights)) {
+    if (width <= 0 || height <= 0 || mWeights.size() != static_cast<size_t>(width) * height) {
+        throw std::runtime_error("Invalid convolution matrix");
+    }
+
+    factor();
+}
+
+Convolution Convolution::parse(const char* spec) {
+    if (!std::strcmp(spec, "sharpen")) return parseRows("0,-1,0;-1,5,-1;0,-1,0", ';');
+    if (!std::strcmp(spec, "emboss")) return parseRows("-2,-1,0;-1,1,1;0,1,2", ';');
+    if (!std::strcmp(spec, "edge")) return parseRows("-1,-1,-1;-1,8,-1;-1,-1,-1", ';');
+
+    if (std::filesystem::is_regular_file(spec)) {
+        std::ifstream file(spec);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open " + std::string(spec));
+        }
+
+        std::stringstream text;
+        text << file.rdbuf();
+        return parseRows(text.str(), '\n');
+    }
+
+    return parseRows(spec, ';');
+}
+
+Convolution Convolution::parseRows(const std::string& text, const char rowSeparator) {
+    std::vector<float> weights;
+    int width = 0, height = 0;
+
+    std::stringstream rows(text);
+    std::string line;
+    while (std::getline(rows, line, rowSeparator)) {
+        // Values are separated by commas and/or whitespace; '#' starts a comment
+        line = line.substr(0, line.find('#'));
+        for (char& c : line) {
+            if (c == ',') c = ' ';
+        }
+
+        std::stringstream values(line);
+        int count = 0;
+        float value;
+        while (values >> value) {
+            weights.push_back(value);
+            ++count;
+        }
+
+        if (!values.eof()) {
+            throw std::runtime_error("Invalid convolution row: " + line);
+        }
+
+        if (count == 0) continue;
+        if (height > 0 && count != width) {
+            throw std::runtime_error("Convolution rows differ in length");
+        }
+        width = count;
+        ++height;
+    }
+
+    if (height == 0) {
+        throw std::runtime_error("Empty convolution matrix");
+    }
+
+    return {width, height, std::move(weights)};
+}
+
+void Convolution::factor() {
+    mSeparable = false;
+    mRow.clear();
+    mColumn.clear();
+
+    // A single row or column is already one pass
+    if (mWidth == 1 || mHeight == 1) return;
+
+    auto at = [this](const int y, const int x) { return static_cast<double>(mWeights[y * mWidth + x]); };
+
+    double norm = 0;
+    int start = 0;
+    for (int y = 0; y < mHeight; ++y) {
+        double rowNorm = 0;
+        for (int x = 0; x < mWidth; ++x) {
+            rowNorm += at(y, x) * at(y, x);
+        }
+        if (rowNorm > norm) {
+            norm = rowNorm;
+            start = y;
+        }
+    }
+    if (norm == 0) return;
+
+    // Leading singular vectors by power iteration on A^T A, starting from the largest
+    // row; a rank-1 matrix converges in one step
+    std::vector<double> u(mHeight), v(mWidth);
+    for (int x = 0; x < mWidth; ++x) {
+        v[x] = at(start, x);
+    }
+
+    double sigma = 0;
+    for (int iteration = 0; iteration < 32; ++iteration) {
+        double length = 0;
+        for (int y = 0; y < mHeight; ++y) {
+            u[y] = 0;
+            for (int x = 0; x < mWidth; ++x) {
+                u[y] += at(y, x) * v[x];
+            }
+            length += u[y] * u[y];
+        }
+        sigma = std::sqrt(length);
+        if (sigma == 0) return;
+        for (double& value : u) value /= sigma;
+
+        length = 0;
+        for (int x = 0; x < mWidth; ++x) {
+            v[x] = 0;
+            for (int y = 0; y < mHeight; ++y) {
+                v[x] += at(y, x) * u[y];
+            }
+            length += v[x] * v[x];
+        }
+        length = std::sqrt(length);
+        for (double& value : v) value /= length;
+    }
+
+    // Rank 1 when the leading singular triplet reproduces the matrix
+    double total = 0, residual = 0;
+    for (int y = 0; y < mHeight; ++y) {
+        for (int x = 0; x < mWidth; ++x) {
+            const double error = at(y, x) - sigma * u[y] * v[x];
+            residual += error * error;
+            total += at(y, x) * at(y, x);
+        }
+    }
+    if (residual > 1e-10 * total) return;
+
+    const double scale = std::sqrt(sigma);
+    for (const double value : v) mRow.push_back(static_cast<float>(value * scale));
+    for (const double value : u) mColumn.push_back(static_cast<float>(value * scale));
+    mSeparable = true;
+}
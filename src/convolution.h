@@ -0,0 +1,48 @@
+#ifndef CONVOLUTION_H
+#define CONVOLUTION_H
+
+#include <string>
+#include <vector>
+
+// Row-major convolution matrix anchored at its centre. On construction the matrix is
+// tested for separability: when it has rank 1 within a small tolerance it factors
+// into a row and a column vector, and the convolution runs as two 1D passes.
+class Convolution {
+public:
+    Convolution() = default;
+
+    Convolution(int width, int height, std::vector<float> weights);
+
+    // A preset (sharpen, emboss, edge), a file holding one matrix row per line, or
+    // inline rows such as "0,-1,0;-1,5,-1;0,-1,0"
+    static Convolution parse(const char* spec);
+
+    [[nodiscard]] int width() const { return mWidth; }
+
+    [[nodiscard]] int height() const { return mHeight; }
+
+    [[nodiscard]] bool empty() const { return mWeights.empty(); }
+
+    [[nodiscard]] const std::vector<float>& weights() const { return mWeights; }
+
+    [[nodiscard]] bool separable() const { return mSeparable; }
+
+    // Factors with weights[y * width + x] ~ column[y] * row[x], valid when separable()
+    [[nodiscard]] const std::vector<float>& row() const { return mRow; }
+
+    [[nodiscard]] const std::vector<float>& column() const { return mColumn; }
+
+private:
+    static Convolution parseRows(const std::string& text, char rowSeparator);
+
+    void factor();
+
+    int mWidth{};
+    int mHeight{};
+    std::vector<float> mWeights;
+    bool mSeparable{false};
+    std::vector<float> mRow;
+    std::vector<float> mColumn;
+};
+
+#endif //CONVOLUTION_H
@@ -0,0 +1,94 @@
+#include "decoder.h"
+#include <algorithm>
+
+Decoder::Decoder(std::vector<std::string> files, const int threads, const size_t memoryLimit,
+                 ImageAllocator& allocator, const DecodeOptions options)
+    : mFiles(std::move(files)), mMemoryLimit(memoryLimit), mAllocator(allocator), mOptions(options) {
+    for (int i = 0; i < std::max(threads, 1); ++i) {
+        mWorkers.emplace_back(&Decoder::work, this);
+    }
+}
+
+Decoder::~Decoder() {
+    {
+        std::lock_guard lock(mMutex);
+        mStopping = true;
+    }
+    mSpace.notify_all();
+
+    for (auto& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+std::optional<Image> Decoder::next() {
+    std::unique_lock lock(mMutex);
+    if (mNextOut == mFiles.size()) return std::nullopt;
+
+    mReady.wait(lock, [this] { return mSlots.contains(mNextOut); });
+
+    auto node = mSlots.extract(mNextOut++);
+    Slot& slot = node.mapped();
+    if (slot.image) {
+        mQueuedBytes -= static_cast<size_t>(slot.image->width()) * slot.image->height() * 4;
+    }
+    lock.unlock();
+    mSpace.notify_all();
+
+    if (slot.error) {
+        std::rethrow_exception(slot.error);
+    }
+
+    return std::move(slot.image);
+}
+
+void Decoder::work() {
+    while (true) {
+        size_t index;
+        {
+            std::unique_lock lock(mMutex);
+            mSpace.wait(lock, [this] {
+                return mStopping || mNextDecode == mFiles.size() || mNextDecode == mNextOut ||
+                       mQueuedBytes < mMemoryLimit;
+            });
+
+            if (mStopping || mNextDecode == mFiles.size()) return;
+            index = mNextDecode++;
+        }
+
+        // The decoded size is reserved up front, so decodes still in progress count against
+        // the limit too; the image the consumer waits on, or an empty queue, always proceeds
+        size_t reserved = 0;
+        if (int width, height; Image::info(mFiles[index].c_str(), width, height)) {
+            reserved = static_cast<size_t>(width) * height * 4;
+
+            std::unique_lock lock(mMutex);
+            mSpace.wait(lock, [&] {
+                return mStopping || index == mNextOut || mQueuedBytes == 0 || mQueuedBytes + reserved <= mMemoryLimit;
+            });
+            if (mStopping) return;
+            mQueuedBytes += reserved;
+        }
+
+        Slot slot;
+        try {
+            slot.image.emplace();
+            slot.image->load(mFiles[index].c_str(), mAllocator, mOptions);
+        } catch (...) {
+            slot.image.reset();
+            slot.error = std::current_exception();
+        }
+
+        {
+            std::lock_guard lock(mMutex);
+            // Scaled decodes come out smaller than the estimate, failed ones take nothing
+            mQueuedBytes -= reserved;
+            if (slot.image) {
+                mQueuedBytes += static_cast<size_t>(slot.image->width()) * slot.image->height() * 4;
+            }
+            mSlots.emplace(index, std::move(slot));
+        }
+        mReady.notify_all();
+        mSpace.notify_all();
+    }
+}
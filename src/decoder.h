@@ -0,0 +1,62 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "image.h"
+
+// Decodes a list of files ahead of the consumer on a pool of threads.
+// Decoded images are handed out in input order. Workers stop prefetching
+// once the decoded-but-unconsumed pixels, plus the header sizes of decodes in
+// progress, would pass the memory limit, except for the image the consumer is
+// waiting on, so a single oversized input cannot stall the batch.
+class Decoder {
+public:
+    // Pixels are allocated from allocator, which must outlive the decoded images
+    Decoder(std::vector<std::string> files, int threads, size_t memoryLimit,
+            ImageAllocator& allocator = ImageAllocator::pool(), DecodeOptions options = {});
+
+    ~Decoder();
+
+    Decoder(const Decoder&) = delete;
+
+    Decoder& operator=(const Decoder&) = delete;
+
+    // Blocks until the next image is ready; returns nothing once every file was
+    // handed out. Rethrows the decode error of that file, if any.
+    std::optional<Image> next();
+
+    [[nodiscard]] const std::string& file(size_t index) const { return mFiles[index]; }
+
+private:
+    struct Slot {
+        std::optional<Image> image;
+        std::exception_ptr error;
+    };
+
+    void work();
+
+    std::vector<std::string> mFiles;
+    size_t mMemoryLimit;
+    ImageAllocator& mAllocator;
+    DecodeOptions mOptions;
+
+    std::mutex mMutex;
+    std::condition_variable mReady;
+    std::condition_variable mSpace;
+    std::map<size_t, Slot> mSlots;
+    size_t mNextDecode{};
+    size_t mNextOut{};
+    size_t mQueuedBytes{};
+    bool mStopping{false};
+
+    std::vector<std::thread> mWorkers;
+};
+
+#endif //DECODER_H
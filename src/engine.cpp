@@ -0,0 +1,1140 @@
+#include "engine.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+namespace {
+// $XDG_CACHE_HOME/pixcl, ~/.cache/pixcl or %LOCALAPPDATA%\pixcl; empty when none is set
+std::filesystem::path cacheDirectory() {
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) return std::filesystem::path(xdg) / "pixcl";
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return std::filesystem::path(home) / ".cache" / "pixcl";
+    }
+    if (const char* local = std::getenv("LOCALAPPDATA"); local && *local) {
+        return std::filesystem::path(local) / "pixcl";
+    }
+    return {};
+}
+}
+
+// Partial result of kernels/stats.cl
+struct StatsPartial {
+    cl_ulong4 sum;
+    cl_ulong4 squares;
+    cl_uint4 min;
+    cl_uint4 max;
+};
+
+Engine::Engine(const DeviceType device) : mPipeline(device), mDevice(device) {
+    // CPUs report their SIMD width here (16 bytes for SSE, 32 for AVX2, 64 for AVX-512);
+    // GPUs report small widths as their lanes are scalar, and keep one pixel per work-item
+    const cl_uint width = mPipeline.preferredCharWidth();
+    mVectors = width >= 16 ? static_cast<int>(std::min<cl_uint>(width / 16, 4)) : 0;
+
+    mTileSize = std::min<size_t>(16, static_cast<size_t>(std::sqrt(mPipeline.maxWorkGroupSize())));
+    // Two local buffers of 64-bit sums per work-item
+    mScanSize = std::bit_floor(std::min<size_t>({256, mPipeline.maxWorkGroupSize(),
+                                                 mPipeline.localMemSize() / (2 * sizeof(cl_ulong4))}));
+    mHistogramGroup = std::bit_floor(std::min<size_t>(256, mPipeline.maxWorkGroupSize()));
+    mStatsGroup = std::bit_floor(std::min<size_t>({256, mPipeline.maxWorkGroupSize(),
+                                                   mPipeline.localMemSize() / (2 * sizeof(StatsPartial))}));
+    mMedianGroup = std::bit_floor(std::min<size_t>(256, mPipeline.maxWorkGroupSize()));
+
+    setPrecision(Precision::FP32);
+    setBilateral(3, 30.0f);
+    setMedianRadius(mMedianRadius);
+}
+
+void Engine::setPrecision(const Precision precision) {
+    if (precision == Precision::FP16 && !mPipeline.hasExtension("cl_khr_fp16")) {
+        throw std::runtime_error("fp16 precision requires cl_khr_fp16");
+    }
+    mPrecision = precision;
+
+    switch (precision) {
+        case Precision::FP32: mPrecisionOptions.clear(); break;
+        case Precision::FP16: mPrecisionOptions = " -DPRECISION_FP16"; break;
+        case Precision::FIXED: mPrecisionOptions = " -DPRECISION_FIXED"; break;
+    }
+
+    // The tile and the weights never change, so they are compiled in as constants
+    mBlurOptions = mPrecisionOptions + CLPipeline::define("TILE_SIZE", mTileSize) +
+                   CLPipeline::define("KERNEL_RADIUS", CLPipeline::gaussianRadius) + " -DWEIGHTS=";
+    for (const float weight : CLPipeline::gaussianKernel) {
+        if (precision == Precision::FIXED) {
+            mBlurOptions += std::format("{},", std::lround(weight * (1 << FIXED_SHIFT)));
+        } else {
+            mBlurOptions += std::format("{:#.9g}f,", weight);
+        }
+    }
+    mBlurOptions.pop_back();
+}
+
+BlurMode Engine::getBlurMode(const char* name) {
+    if (!std::strcmp(name, "exact")) return BlurMode::EXACT;
+    if (!std::strcmp(name, "approx")) return BlurMode::APPROX;
+
+    throw std::runtime_error("Unknown Blur Mode: " + std::string(name));
+}
+
+void Engine::setBlurMode(const BlurMode mode, const float sigma) {
+    if (!(sigma > 0)) {
+        throw std::runtime_error("Invalid sigma: " + std::to_string(sigma));
+    }
+    mBlurMode = mode;
+    mApproxRadii = boxRadii(sigma);
+}
+
+void Engine::setBoxRadius(const int radius) {
+    if (radius < 0) {
+        throw std::runtime_error("Invalid box radius: " + std::to_string(radius));
+    }
+    mBoxRadius = radius;
+}
+
+void Engine::setThreshold(const int radius, const float bias) {
+    if (radius < 0) {
+        throw std::runtime_error("Invalid threshold radius: " + std::to_string(radius));
+    }
+    mThresholdRadius = radius;
+    mThresholdBias = bias;
+}
+
+void Engine::setBilateral(const int radius, const float sigmaRange) {
+    if (radius < 0 || !(sigmaRange > 0)) {
+        throw std::runtime_error("Invalid bilateral radius or sigma");
+    }
+    mBilateralRadius = radius;
+
+    // exp() per weight happens here, once, instead of per tap in the kernels
+    const double sigmaSpatial = std::max(radius / 2.0, 0.5);
+    std::vector<double> row(2 * radius + 1);
+    for (int i = -radius; i <= radius; ++i) {
+        row[i + radius] = std::exp(-i * i / (2 * sigmaSpatial * sigmaSpatial));
+    }
+
+    const std::string common = CLPipeline::define("RADIUS", radius) + CLPipeline::define("TILE_SIZE", mTileSize);
+    mBilateralSeparableOptions = common + " -DSEPARABLE -DSPATIAL=";
+    for (const double y : row) {
+        mBilateralSeparableOptions += std::format("{:#.9g}f,", y);
+    }
+    mBilateralSeparableOptions.pop_back();
+
+    // The full matrix grows with the square of the radius, so larger radii only run separable
+    mBilateralOptions.clear();
+    if (radius <= BILATERAL_SEPARABLE_RADIUS) {
+        mBilateralOptions = common + " -DSPATIAL=";
+        for (const double y : row) {
+            for (const double x : row) {
+                mBilateralOptions += std::format("{:#.9g}f,", x * y);
+            }
+        }
+        mBilateralOptions.pop_back();
+    }
+
+    // Indexed by rounded distance up to sqrt(3) * 255, matching RANGE_SIZE in bilateral.cl
+    std::vector<float> range(443);
+    for (size_t d = 0; d < range.size(); ++d) {
+        range[d] = static_cast<float>(std::exp(-static_cast<double>(d * d) / (2.0 * sigmaRange * sigmaRange)));
+    }
+    mRangeWeights = mPipeline.createBuffer(range.size() * sizeof(float), CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                           range.data());
+}
+
+void Engine::setMedianRadius(const int radius) {
+    // Column counts are kept in 8-bit bins
+    if (radius < 0 || radius > 127) {
+        throw std::runtime_error("Invalid median radius: " + std::to_string(radius));
+    }
+    mMedianRadius = radius;
+    mMedianOptions = CLPipeline::define("RADIUS", radius) + CLPipeline::define("MEDIAN_GROUP", mMedianGroup);
+}
+
+void Engine::setCanny(const float low, const float high) {
+    if (low < 0 || high < low) {
+        throw std::runtime_error("Invalid Canny thresholds");
+    }
+    mCannyLow = low;
+    mCannyHigh = high;
+}
+
+void Engine::setClahe(const int tiles, const float clip) {
+    if (tiles < 1 || !(clip > 0)) {
+        throw std::runtime_error("Invalid CLAHE tiles or clip limit");
+    }
+    mClaheTiles = tiles;
+    mClaheClip = clip;
+}
+
+void Engine::setResize(const int width, const int height, const ResizeFilter filter) {
+    if (width < 0 || height < 0 || (width == 0 && height == 0)) {
+        throw std::runtime_error("Invalid resize dimensions");
+    }
+
+    mResizeWidth = width;
+    mResizeHeight = height;
+    mResizer.setFilter(filter);
+}
+
+std::pair<int, int> Engine::outputSize(const std::span<const Effect> chain, int width, int height) const {
+    for (const Effect effect : chain) {
+        if (effect == Effect::RESIZE) {
+            std::tie(width, height) = resizedSize(width, height);
+        }
+    }
+
+    return {width, height};
+}
+
+std::pair<int, int> Engine::resizedSize(const int width, const int height) const {
+    if (mResizeWidth == 0 && mResizeHeight == 0) {
+        throw std::runtime_error("No resize dimensions set");
+    }
+
+    // The missing side follows the aspect ratio, rounded and at least a pixel
+    if (mResizeWidth == 0) {
+        return {std::max(1, static_cast<int>(std::lround(static_cast<double>(width) * mResizeHeight / height))),
+                mResizeHeight};
+    }
+    if (mResizeHeight == 0) {
+        return {mResizeWidth,
+                std::max(1, static_cast<int>(std::lround(static_cast<double>(height) * mResizeWidth / width)))};
+    }
+
+    return {mResizeWidth, mResizeHeight};
+}
+
+std::array<int, 3> Engine::boxRadii(const float sigma) {
+    // Box widths around sqrt(12 sigma^2 / n + 1) give n boxes the variance of the
+    // Gaussian; the first m take the odd width below, the rest the one above
+    constexpr int n = 3;
+    const double variance = 12.0 * sigma * sigma;
+    int lower = static_cast<int>(std::floor(std::sqrt(variance / n + 1)));
+    if (lower % 2 == 0) --lower;
+    const long m = std::lround((variance - n * lower * lower - 4 * n * lower - 3 * n) / (-4.0 * lower - 4));
+
+    std::array<int, 3> radii{};
+    for (int i = 0; i < n; ++i) {
+        const int width = i < m ? lower : lower + 2;
+        radii[i] = (width - 1) / 2;
+    }
+    return radii;
+}
+
+void Engine::setConvolution(Convolution convolution) {
+    mConvolution = std::move(convolution);
+
+    std::vector<float> weights = mConvolution.weights();
+    if (mConvolution.separable()) {
+        weights.insert(weights.end(), mConvolution.row().begin(), mConvolution.row().end());
+        weights.insert(weights.end(), mConvolution.column().begin(), mConvolution.column().end());
+    }
+    mConvolutionWeights = mPipeline.createBuffer(weights.size() * sizeof(float),
+                                                 CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, weights.data());
+
+    mConvolutionOptions = CLPipeline::define("KERNEL_WIDTH", mConvolution.width()) +
+                          CLPipeline::define("KERNEL_HEIGHT", mConvolution.height()) +
+                          CLPipeline::define("TILE_SIZE", mTileSize);
+    if (weights.size() * sizeof(float) > mPipeline.maxConstantSize()) {
+        mConvolutionOptions += " -DWEIGHT_SPACE=__global";
+    }
+
+    mFft.setMatrix(mConvolution);
+}
+
+bool Engine::convolvesWithFft() const {
+    const int taps = mConvolution.width() * mConvolution.height();
+    const bool twoPass = mConvolution.separable() && mConvolution.width() + mConvolution.height() < taps / 2;
+    // Past the crossover the transforms cost less than the taps
+    return !twoPass && static_cast<size_t>(taps) > mFftCrossover;
+}
+
+size_t Engine::calibrateFftCrossover() {
+    const std::string device = mPipeline.deviceDescription();
+    const std::filesystem::path directory = cacheDirectory();
+    const std::filesystem::path cache = directory.empty() ? directory : directory / "fft-crossover";
+
+    // One "<device>\t<taps>" line per device measured; a corrupt line is measured again
+    if (std::ifstream file(cache); !cache.empty() && file) {
+        for (std::string line; std::getline(file, line);) {
+            const size_t tab = line.rfind('\t');
+            if (tab == device.size() && line.compare(0, tab, device) == 0) {
+                size_t taps{};
+                const char* end = line.data() + line.size();
+                const auto [last, error] = std::from_chars(line.data() + tab + 1, end, taps);
+                if (error == std::errc() && last == end) {
+                    mFftCrossover = taps;
+                    return mFftCrossover;
+                }
+            }
+        }
+    }
+
+    // Large enough that launch overhead does not decide, small enough to measure quickly;
+    // CPUs take far longer over the large direct matrices, so they time a sixteenth of the pixels
+    const int width = mDevice == DeviceType::CPU ? 256 : 1024, height = width;
+    const size_t bytes = static_cast<size_t>(width) * height * sizeof(cl_uchar4);
+    std::mt19937 random(1);
+    std::vector<uint8_t> pixels(bytes);
+    for (uint8_t& value : pixels) {
+        value = static_cast<uint8_t>(random());
+    }
+    const CLMem input = mPipeline.createBuffer(bytes, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, pixels.data());
+    const CLMem output = mPipeline.createBuffer(bytes, CL_MEM_READ_WRITE);
+
+    const Convolution saved = mConvolution;
+
+    // The crossover lands below the first size the transforms win at; random weights
+    // are not separable, so the direct path is the one-pass kernel
+    size_t crossover = 0;
+    for (const int side : {3, 9, 15, 21, 31, 45, 63}) {
+        std::uniform_real_distribution<float> weight(0.0f, 2.0f / (side * side));
+        std::vector<float> weights(static_cast<size_t>(side) * side);
+        for (float& w : weights) {
+            w = weight(random);
+        }
+        setConvolution(Convolution(side, side, std::move(weights)));
+
+        mFftCrossover = SIZE_MAX;
+        const double direct = timeConvolution(input.get(), output.get(), width, height);
+        mFftCrossover = 0;
+        const double fft = timeConvolution(input.get(), output.get(), width, height);
+        if (fft < direct) break;
+
+        crossover = static_cast<size_t>(side) * side;
+    }
+
+    if (!saved.empty()) {
+        setConvolution(saved);
+    } else {
+        mConvolution = saved;
+    }
+    mFftCrossover = crossover;
+
+    // A failed write only costs a measurement next time
+    if (!cache.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(cache.parent_path(), error);
+        std::ofstream(cache, std::ios::app) << device << '\t' << crossover << '\n';
+    }
+    return crossover;
+}
+
+double Engine::timeConvolution(cl_mem input, cl_mem output, const int width, const int height) {
+    // The first run builds the kernels
+    runEffect(Effect::CONVOLVE, input, output, width, height);
+    mPipeline.finish();
+
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < 3; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        runEffect(Effect::CONVOLVE, input, output, width, height);
+        mPipeline.finish();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+Precision Engine::getPrecision(const char* name) {
+    if (!std::strcmp(name, "fp32")) return Precision::FP32;
+    if (!std::strcmp(name, "fp16")) return Precision::FP16;
+    if (!std::strcmp(name, "fixed")) return Precision::FIXED;
+
+    throw std::runtime_error("Unknown Precision: " + std::string(name));
+}
+
+Effect Engine::getEffect(const char* name) {
+    if (!std::strcmp(name, "gb")) return Effect::GAUSSIAN_BLUR;
+    if (!std::strcmp(name, "gs")) return Effect::GRAYSCALE;
+    if (!std::strcmp(name, "sep")) return Effect::SEPIA;
+    if (!std::strcmp(name, "conv")) return Effect::CONVOLVE;
+    if (!std::strcmp(name, "box")) return Effect::BOX_BLUR;
+    if (!std::strcmp(name, "thr")) return Effect::ADAPTIVE_THRESHOLD;
+    if (!std::strcmp(name, "bl")) return Effect::BILATERAL;
+    if (!std::strcmp(name, "med")) return Effect::MEDIAN;
+    if (!std::strcmp(name, "sobel")) return Effect::SOBEL;
+    if (!std::strcmp(name, "canny")) return Effect::CANNY;
+    if (!std::strcmp(name, "eq")) return Effect::EQUALISE;
+    if (!std::strcmp(name, "clahe")) return Effect::CLAHE;
+    if (!std::strcmp(name, "resize")) return Effect::RESIZE;
+
+    throw std::runtime_error("Unknown Effect: " + std::string(name));
+}
+
+std::vector<Effect> Engine::getEffects(const char* names) {
+    std::vector<Effect> chain;
+    const std::string list(names);
+
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        const size_t end = std::min(list.find(',', begin), list.size());
+        chain.push_back(getEffect(list.substr(begin, end - begin).c_str()));
+        begin = end + 1;
+    }
+
+    return chain;
+}
+
+int Engine::channels(const PixelFormat format) {
+    switch (format) {
+        case PixelFormat::RGBA8: return 4;
+        case PixelFormat::RGB8:  return 3;
+        case PixelFormat::GRAY8: return 1;
+    }
+
+    return 0;
+}
+
+void Engine::process(const Effect effect, const PixelBuffer& src, const PixelBuffer& dst) {
+    process(std::span(&effect, 1), src, dst);
+}
+
+void Engine::process(const std::span<const Effect> chain, const PixelBuffer& src, const PixelBuffer& dst) {
+    if (chain.empty()) {
+        throw std::runtime_error("Empty effect chain");
+    }
+    const auto [outWidth, outHeight] = outputSize(chain, src.width, src.height);
+    validate(src, dst, outWidth, outHeight);
+
+    runChain(chain, src);
+    if (mStatisticsEnabled) {
+        computeStatistics(mOutput.get(), outWidth * outHeight);
+    }
+
+    download(dst);
+}
+
+void Engine::processEach(const std::span<const Effect> effects, const PixelBuffer& src,
+                         const std::span<const PixelBuffer> dsts) {
+    if (effects.empty()) {
+        throw std::runtime_error("Empty effect list");
+    }
+    if (effects.size() != dsts.size()) {
+        throw std::runtime_error("Effect and destination counts differ");
+    }
+    size_t pixels = static_cast<size_t>(src.width) * src.height;
+    for (size_t i = 0; i < effects.size(); ++i) {
+        const auto [width, height] = outputSize(effects.subspan(i, 1), src.width, src.height);
+        validate(src, dsts[i], width, height);
+        pixels = std::max(pixels, static_cast<size_t>(width) * height);
+    }
+
+    reserve(pixels);
+    // Every effect reads the uploaded pixels, so a table built for one serves the rest
+    cl_mem input = upload(src);
+    for (size_t i = 0; i < effects.size(); ++i) {
+        runEffect(effects[i], input, mOutput.get(), src.width, src.height);
+        if (mStatisticsEnabled) {
+            computeStatistics(mOutput.get(), dsts[i].width * dsts[i].height);
+        }
+        download(dsts[i]);
+    }
+}
+
+void Engine::pyramid(const std::span<const Effect> chain, const PixelBuffer& src,
+                     const std::span<const PixelBuffer> levels) {
+    if (chain.empty()) {
+        throw std::runtime_error("Empty effect chain");
+    }
+    if (levels.empty()) {
+        throw std::runtime_error("Empty pyramid");
+    }
+    auto [width, height] = outputSize(chain, src.width, src.height);
+    validate(src, levels[0], width, height);
+    for (size_t i = 1; i < levels.size(); ++i) {
+        std::tie(width, height) = nextLevel(width, height);
+        validate(src, levels[i], width, height);
+    }
+
+    runChain(chain, src);
+    if (mStatisticsEnabled) {
+        computeStatistics(mOutput.get(), levels[0].width * levels[0].height);
+    }
+    download(levels[0]);
+
+    // Every level is resampled from the one before, which was downloaded already and can be overwritten next
+    for (size_t i = 1; i < levels.size(); ++i) {
+        const PixelBuffer& from = levels[i - 1];
+        invalidateIntegral(mInput.get());
+        mResizer.run(mOutput.get(), mInput.get(), from.width, from.height, levels[i].width, levels[i].height);
+        std::swap(mInput, mOutput);
+        download(levels[i]);
+    }
+}
+
+std::pair<int, int> Engine::nextLevel(const int width, const int height) {
+    return {std::max(1, (width + 1) / 2), std::max(1, (height + 1) / 2)};
+}
+
+void Engine::runChain(const std::span<const Effect> chain, const PixelBuffer& src) {
+    // Both buffers hold every intermediate, so they take the largest size along the chain
+    int width = src.width, height = src.height;
+    size_t pixels = static_cast<size_t>(width) * height;
+    for (const Effect effect : chain) {
+        if (effect == Effect::RESIZE) {
+            std::tie(width, height) = resizedSize(width, height);
+            pixels = std::max(pixels, static_cast<size_t>(width) * height);
+        }
+    }
+    reserve(pixels);
+    cl_mem input = upload(src);
+
+    // Ping-pong between the two device buffers; the last output ends up in mOutput
+    width = src.width;
+    height = src.height;
+    for (const Effect effect : chain) {
+        invalidateIntegral(mOutput.get());
+        runEffect(effect, input, mOutput.get(), width, height);
+        if (effect == Effect::RESIZE) {
+            std::tie(width, height) = resizedSize(width, height);
+        }
+        std::swap(mInput, mOutput);
+        input = mInput.get();
+    }
+    std::swap(mInput, mOutput);
+}
+
+void Engine::processBatch(const std::span<const Effect> chain, const std::span<const PixelBuffer> srcs,
+                          const std::span<const PixelBuffer> dsts) {
+    if (chain.empty()) {
+        throw std::runtime_error("Empty effect chain");
+    }
+
+    if (srcs.size() != dsts.size()) {
+        throw std::runtime_error("Batch sources and destinations differ in count");
+    }
+
+    if (srcs.empty()) return;
+
+    // Offset/size table, in pixels, describing where each image lives in the packed buffer
+    mEntries.resize(srcs.size());
+    size_t pixels = 0;
+    int maxWidth = 0, maxHeight = 0;
+    for (size_t i = 0; i < srcs.size(); ++i) {
+        validate(srcs[i], dsts[i], srcs[i].width, srcs[i].height);
+
+        mEntries[i] = {{static_cast<cl_int>(pixels), srcs[i].width, srcs[i].height, 0}};
+        pixels += static_cast<size_t>(srcs[i].width) * srcs[i].height;
+        maxWidth = std::max(maxWidth, srcs[i].width);
+        maxHeight = std::max(maxHeight, srcs[i].height);
+    }
+
+    reserve(pixels);
+    if (mEntries.size() > mTableCapacity) {
+        mTable = mPipeline.createBuffer(mEntries.size() * sizeof(cl_int4), CL_MEM_READ_ONLY);
+        mTableCapacity = mEntries.size();
+    }
+    mPipeline.writeBytes(mTable.get(), mEntries.data(), mEntries.size() * sizeof(cl_int4));
+
+    // Batches do not read tables, but they overwrite both buffers
+    mIntegralSource = nullptr;
+    mUploadStaging.resize(pixels * 4);
+    for (size_t i = 0; i < srcs.size(); ++i) {
+        pack(srcs[i], mUploadStaging.data() + static_cast<size_t>(mEntries[i].s[0]) * 4);
+    }
+    mPipeline.writeBuffer(mInput.get(), mUploadStaging.data(), static_cast<int>(pixels), 1, 4);
+
+    for (const Effect effect : chain) {
+        bindBatchedEffect(effect);
+        mPipeline.executeBatch(maxWidth, maxHeight, static_cast<int>(srcs.size()));
+        std::swap(mInput, mOutput);
+    }
+    std::swap(mInput, mOutput);
+
+    // One transfer back for the whole batch, then scatter into the destinations
+    mDownloadStaging.resize(pixels * 4);
+    mPipeline.readBuffer(mOutput.get(), mDownloadStaging.data(), static_cast<int>(pixels), 1);
+    for (size_t i = 0; i < dsts.size(); ++i) {
+        unpack(mDownloadStaging.data() + static_cast<size_t>(mEntries[i].s[0]) * 4, dsts[i]);
+    }
+}
+
+std::array<uint32_t, 256> Engine::histogram(const PixelBuffer& src) {
+    if (src.data == nullptr) {
+        throw std::runtime_error("Invalid pixel buffer");
+    }
+
+    reserve(static_cast<size_t>(src.width) * src.height);
+    computeHistogram(upload(src), src.width * src.height);
+
+    std::array<uint32_t, 256> bins{};
+    mPipeline.readBytes(mBins.get(), bins.data(), sizeof(bins));
+    return bins;
+}
+
+void Engine::validate(const PixelBuffer& src, const PixelBuffer& dst, int width, int height) {
+    if (src.data == nullptr || dst.data == nullptr) {
+        throw std::runtime_error("Invalid pixel buffer");
+    }
+
+    if (dst.width != width || dst.height != height) {
+        throw std::runtime_error("Destination dimensions do not match the output");
+    }
+}
+
+void Engine::pack(const PixelBuffer& src, uint8_t* rgba) {
+    const int channels = Engine::channels(src.format);
+    const size_t stride = src.stride ? src.stride : static_cast<size_t>(src.width) * channels;
+
+    for (int y = 0; y < src.height; ++y) {
+        const uint8_t* row = src.data + y * stride;
+        uint8_t* out = rgba + static_cast<size_t>(y) * src.width * 4;
+
+        if (src.format == PixelFormat::RGBA8) {
+            std::memcpy(out, row, static_cast<size_t>(src.width) * 4);
+            continue;
+        }
+
+        for (int x = 0; x < src.width; ++x, out += 4) {
+            const uint8_t* px = row + x * channels;
+            if (src.format == PixelFormat::RGB8) {
+                out[0] = px[0];
+                out[1] = px[1];
+                out[2] = px[2];
+            } else {
+                out[0] = out[1] = out[2] = px[0];
+            }
+            out[3] = 255;
+        }
+    }
+}
+
+void Engine::unpack(const uint8_t* rgba, const PixelBuffer& dst) {
+    const int channels = Engine::channels(dst.format);
+    const size_t stride = dst.stride ? dst.stride : static_cast<size_t>(dst.width) * channels;
+
+    for (int y = 0; y < dst.height; ++y) {
+        const uint8_t* in = rgba + static_cast<size_t>(y) * dst.width * 4;
+        uint8_t* row = dst.data + y * stride;
+
+        if (dst.format == PixelFormat::RGBA8) {
+            std::memcpy(row, in, static_cast<size_t>(dst.width) * 4);
+            continue;
+        }
+
+        for (int x = 0; x < dst.width; ++x, in += 4) {
+            uint8_t* px = row + x * channels;
+            if (dst.format == PixelFormat::RGB8) {
+                px[0] = in[0];
+                px[1] = in[1];
+                px[2] = in[2];
+            } else {
+                // Rec. 601 luma, matching grayscale.cl
+                px[0] = static_cast<uint8_t>(0.299f * in[0] + 0.587f * in[1] + 0.114f * in[2]);
+            }
+        }
+    }
+}
+
+bool Engine::isPackedRGBA(const PixelBuffer& buffer) {
+    return buffer.format == PixelFormat::RGBA8 &&
+           (buffer.stride == 0 || buffer.stride == static_cast<size_t>(buffer.width) * 4);
+}
+
+void Engine::reserve(const size_t pixels) {
+    if (pixels <= mCapacity) return;
+
+    mInput = mPipeline.createBuffer(pixels * sizeof(cl_uchar4), CL_MEM_READ_WRITE);
+    mOutput = mPipeline.createBuffer(pixels * sizeof(cl_uchar4), CL_MEM_READ_WRITE);
+    mCapacity = pixels;
+}
+
+void Engine::reserveImage(const int width, const int height) {
+    if (mImage && width == mImageWidth && height == mImageHeight) return;
+
+    mImage = mPipeline.createImage(width, height, CL_MEM_READ_ONLY);
+    mImageWidth = width;
+    mImageHeight = height;
+}
+
+void Engine::reserveScratch(const size_t pixels, const int count) {
+    for (int i = 0; i < count; ++i) {
+        if (pixels <= mScratchCapacity[i]) continue;
+
+        mScratch[i] = mPipeline.createBuffer(pixels * sizeof(cl_float4), CL_MEM_READ_WRITE);
+        mScratchCapacity[i] = pixels;
+    }
+}
+
+cl_mem Engine::upload(const PixelBuffer& src) {
+    // New pixels arrive in mInput or a pinned buffer, and reserve() may have replaced mInput
+    mIntegralSource = nullptr;
+
+    // Fast path: the device consumes packed RGBA, so no repacking is needed
+    if (isPackedRGBA(src)) {
+        // Decoded straight into a device buffer, nothing to transfer
+        if (cl_mem pinned = mPinned.acquire(src.data)) return pinned;
+
+        mPipeline.writeBuffer(mInput.get(), src.data, src.width, src.height, 4);
+        return mInput.get();
+    }
+
+    mUploadStaging.resize(static_cast<size_t>(src.width) * src.height * 4);
+    pack(src, mUploadStaging.data());
+    mPipeline.writeBuffer(mInput.get(), mUploadStaging.data(), src.width, src.height, 4);
+    return mInput.get();
+}
+
+void Engine::download(const PixelBuffer& dst) {
+    if (isPackedRGBA(dst)) {
+        mPipeline.readBuffer(mOutput.get(), dst.data, dst.width, dst.height);
+        return;
+    }
+
+    mDownloadStaging.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+    mPipeline.readBuffer(mOutput.get(), mDownloadStaging.data(), dst.width, dst.height);
+    unpack(mDownloadStaging.data(), dst);
+}
+
+void Engine::runEffect(const Effect effect, cl_mem input, cl_mem output, const int width, const int height) {
+    const int pixels = width * height;
+    const size_t items = mVectors ? (static_cast<size_t>(pixels) + mVectors * 4 - 1) / (mVectors * 4) : 0;
+    const std::string frame = mSpecialised
+                                  ? CLPipeline::define("WIDTH", width) + CLPipeline::define("HEIGHT", height)
+                                  : std::string();
+    const std::string vectors = mVectors ? CLPipeline::define("VECTORS", mVectors) : std::string();
+
+    switch (effect) {
+        case Effect::GAUSSIAN_BLUR:
+            if (mBlurMode == BlurMode::APPROX) {
+                runBoxes(input, output, width, height, mApproxRadii);
+                break;
+            }
+            if (mWeights == nullptr) {
+                mWeights = mPipeline.createBuffer(BufferType::KERNEL);
+            }
+            mPipeline.createProgram("gaussian_blur", frame + mBlurOptions);
+            // Texture path: the sampler handles borders and the texture cache the overlapping taps.
+            // It samples normalised floats, so reduced precision runs on the tiled kernel.
+            if (mPrecision == Precision::FP32 && mPipeline.supportsImage(width, height)) {
+                reserveImage(width, height);
+                mPipeline.copyToImage(input, mImage.get(), width, height);
+                mPipeline.createKernel("gaussian_blur_image");
+                mPipeline.setKernelArgs(mImage, output, width, height, mWeights);
+                mPipeline.execute(width, height);
+                break;
+            }
+            mPipeline.createKernel("gaussian_blur");
+            mPipeline.setKernelArgs(input, output, width, height, mWeights);
+            // Must match the tile the program was built for
+            mPipeline.execute(width, height, mTileSize);
+            break;
+        case Effect::GRAYSCALE:
+            mPipeline.createProgram("grayscale", frame + vectors);
+            if (mVectors) {
+                mPipeline.createKernel("grayscale_vec");
+                mPipeline.setKernelArgs(input, output, pixels, mVectors);
+                mPipeline.executeLinear(items);
+                break;
+            }
+            mPipeline.createKernel("grayscale");
+            mPipeline.setKernelArgs(input, output, width, height);
+            mPipeline.execute(width, height);
+            break;
+        case Effect::SEPIA:
+            mPipeline.createProgram("sepia_filter", frame + vectors + mPrecisionOptions);
+            if (mVectors) {
+                mPipeline.createKernel("sepia_filter_vec");
+                mPipeline.setKernelArgs(input, output, pixels, mVectors);
+                mPipeline.executeLinear(items);
+                break;
+            }
+            mPipeline.createKernel("sepia_filter");
+            mPipeline.setKernelArgs(input, output, width, height);
+            mPipeline.execute(width, height);
+            break;
+        case Effect::CONVOLVE: {
+            if (mConvolution.empty()) {
+                throw std::runtime_error("No convolution matrix set");
+            }
+            const int kernelWidth = mConvolution.width();
+            const int kernelHeight = mConvolution.height();
+            const int taps = kernelWidth * kernelHeight;
+            // Two passes pay off once they save more than half of the taps
+            const bool twoPass = mConvolution.separable() && kernelWidth + kernelHeight < taps / 2;
+
+            if (convolvesWithFft()) {
+                mFft.run(input, output, width, height);
+                break;
+            }
+
+            mPipeline.createProgram("convolve", frame + mConvolutionOptions);
+
+            if (twoPass) {
+                reserveScratch(static_cast<size_t>(pixels));
+                mPipeline.createKernel("convolve_rows");
+                mPipeline.setKernelArgs(input, mScratch[0], width, height, mConvolutionWeights);
+                mPipeline.execute(width, height);
+                mPipeline.createKernel("convolve_columns");
+                mPipeline.setKernelArgs(mScratch[0], output, width, height, mConvolutionWeights);
+                mPipeline.execute(width, height);
+                break;
+            }
+
+            // Beyond 3x3 each pixel is reused by enough taps to stage tiles in local memory
+            const size_t tileBytes = (mTileSize + kernelWidth - 1) * (mTileSize + kernelHeight - 1) *
+                                     sizeof(cl_uchar4);
+            if (taps > 9 && tileBytes <= mPipeline.localMemSize() / 2) {
+                mPipeline.createKernel("convolve_tiled");
+                mPipeline.setKernelArgs(input, output, width, height, mConvolutionWeights);
+                mPipeline.execute(width, height, mTileSize);
+                break;
+            }
+
+            mPipeline.createKernel("convolve");
+            mPipeline.setKernelArgs(input, output, width, height, mConvolutionWeights);
+            mPipeline.execute(width, height);
+            break;
+        }
+        case Effect::BOX_BLUR: {
+            // Builds the integral program, whose options match the table's accumulators
+            cl_mem table = integral(input, width, height);
+            mPipeline.createKernel("box_blur_table");
+            mPipeline.setKernelArgs(table, output, width, height, mBoxRadius);
+            mPipeline.execute(width, height);
+            break;
+        }
+        case Effect::ADAPTIVE_THRESHOLD: {
+            cl_mem table = integral(input, width, height);
+            mPipeline.createKernel("adaptive_threshold");
+            mPipeline.setKernelArgs(input, output, table, width, height, mThresholdRadius, mThresholdBias);
+            mPipeline.execute(width, height);
+            break;
+        }
+        case Effect::BILATERAL: {
+            // The tile has to fit local memory next to what the driver reserves
+            const size_t span = mTileSize + 2 * mBilateralRadius;
+            if (mBilateralRadius <= BILATERAL_SEPARABLE_RADIUS &&
+                span * span * sizeof(cl_uchar4) <= mPipeline.localMemSize() / 2) {
+                mPipeline.createProgram("bilateral", mBilateralOptions);
+                mPipeline.createKernel("bilateral");
+                mPipeline.setKernelArgs(input, output, width, height, mRangeWeights);
+                mPipeline.execute(width, height, mTileSize);
+                break;
+            }
+
+            reserveScratch(static_cast<size_t>(pixels));
+            mPipeline.createProgram("bilateral", mBilateralSeparableOptions);
+            mPipeline.createKernel("bilateral_rows");
+            mPipeline.setKernelArgs(input, mScratch[0], width, height, mRangeWeights);
+            mPipeline.execute(width, height);
+            mPipeline.createKernel("bilateral_columns");
+            mPipeline.setKernelArgs(mScratch[0], output, width, height, mRangeWeights);
+            mPipeline.execute(width, height);
+            break;
+        }
+        case Effect::MEDIAN:
+            mPipeline.createProgram("median", mMedianOptions);
+            if (mMedianRadius > MEDIAN_NETWORK_RADIUS) {
+                // Strips at least a window tall keep the column histogram setup constant per pixel
+                const int rows = std::max(MEDIAN_STRIP_ROWS, 2 * mMedianRadius + 1);
+                const int strips = (height + rows - 1) / rows;
+                // 256 one-byte bins per column and channel for every strip
+                reserveScratch(static_cast<size_t>(strips) * width * 3 * 256 / sizeof(cl_float4));
+                mPipeline.createKernel("median_histogram");
+                mPipeline.setKernelArgs(input, output, mScratch[0], width, height, rows);
+                mPipeline.executeLinear(strips * mMedianGroup, mMedianGroup);
+            } else if (mVectors) {
+                mPipeline.createKernel("median_vec");
+                mPipeline.setKernelArgs(input, output, width, height);
+                mPipeline.execute((width + 3) / 4, height);
+            } else {
+                mPipeline.createKernel("median");
+                mPipeline.setKernelArgs(input, output, width, height);
+                mPipeline.execute(width, height);
+            }
+            break;
+        case Effect::SOBEL:
+            // Grayscale into the scratch buffer, which has room for far more than uchar4 pixels
+            reserveScratch(static_cast<size_t>(pixels));
+            runEffect(Effect::GRAYSCALE, input, mScratch[0].get(), width, height);
+            mPipeline.createProgram("edges");
+            mPipeline.createKernel("sobel");
+            mPipeline.setKernelArgs(mScratch[0], output, width, height);
+            mPipeline.execute(width, height);
+            break;
+        case Effect::CANNY: {
+            reserveScratch(static_cast<size_t>(pixels), 2);
+            runEffect(Effect::GRAYSCALE, input, mScratch[0].get(), width, height);
+            mPipeline.createProgram("edges");
+            mPipeline.createKernel("canny_gradient");
+            mPipeline.setKernelArgs(mScratch[0], mScratch[1], width, height);
+            mPipeline.execute(width, height);
+            mPipeline.createKernel("canny_suppress");
+            mPipeline.setKernelArgs(mScratch[1], output, width, height, mCannyLow, mCannyHigh);
+            mPipeline.execute(width, height);
+
+            // Strong edges spread through weak ones one pixel per pass at worst, so passes
+            // repeat until one changes nothing; the flag is only read back every few passes
+            if (!mChanged) {
+                mChanged = mPipeline.createBuffer(sizeof(cl_int), CL_MEM_READ_WRITE);
+            }
+            static constexpr cl_int unchanged = 0;
+            mPipeline.createKernel("canny_hysteresis");
+            mPipeline.setKernelArgs(output, width, height, mChanged);
+            for (cl_int changed = 1; changed;) {
+                mPipeline.writeBytes(mChanged.get(), &unchanged, sizeof(unchanged));
+                for (int i = 0; i < HYSTERESIS_PASSES; ++i) {
+                    mPipeline.execute(width, height);
+                }
+                mPipeline.readBytes(mChanged.get(), &changed, sizeof(changed));
+            }
+
+            mPipeline.createKernel("canny_finish");
+            mPipeline.setKernelArgs(output, width, height);
+            mPipeline.execute(width, height);
+            break;
+        }
+        case Effect::EQUALISE:
+            computeHistogram(input, pixels);
+            if (!mLut) {
+                mLut = mPipeline.createBuffer(256, CL_MEM_READ_WRITE);
+            }
+            mPipeline.createKernel("equalise_lut");
+            mPipeline.setKernelArgs(mBins, mLut, pixels);
+            mPipeline.executeLinear(1);
+            mPipeline.createKernel("equalise");
+            mPipeline.setKernelArgs(input, output, mLut, pixels);
+            mPipeline.executeLinear(pixels);
+            break;
+        case Effect::CLAHE: {
+            // Tiles of at least a pixel
+            const int tilesX = std::min(mClaheTiles, width);
+            const int tilesY = std::min(mClaheTiles, height);
+            const size_t tiles = static_cast<size_t>(tilesX) * tilesY;
+            if (tiles * 256 > mTileLutCapacity) {
+                mTileLuts = mPipeline.createBuffer(tiles * 256, CL_MEM_READ_WRITE);
+                mTileLutCapacity = tiles * 256;
+            }
+
+            mPipeline.createProgram("histogram");
+            mPipeline.createKernel("clahe_lut");
+            mPipeline.setKernelArgs(input, mTileLuts, width, height, tilesX, tilesY, mClaheClip);
+            mPipeline.executeLinear(tiles * mHistogramGroup, mHistogramGroup);
+            mPipeline.createKernel("clahe");
+            mPipeline.setKernelArgs(input, output, mTileLuts, width, height, tilesX, tilesY);
+            mPipeline.execute(width, height);
+            break;
+        }
+        case Effect::RESIZE: {
+            const auto [outWidth, outHeight] = resizedSize(width, height);
+            mResizer.run(input, output, width, height, outWidth, outHeight);
+            break;
+        }
+    }
+}
+
+cl_mem Engine::integral(cl_mem input, const int width, const int height) {
+    // 255 per pixel and channel must fit the accumulators
+    const bool wide = 255ull * width * height > UINT32_MAX;
+    // Built even when the table is reused, for the consumer kernels next to it
+    mPipeline.createProgram("integral", CLPipeline::define("SCAN_SIZE", mScanSize) + (wide ? " -DWIDE_SUM" : ""));
+    if (input == mIntegralSource) return mIntegral.get();
+
+    const size_t bytes = static_cast<size_t>(width) * height * (wide ? sizeof(cl_ulong4) : sizeof(cl_uint4));
+    if (bytes > mIntegralCapacity) {
+        mIntegral = mPipeline.createBuffer(bytes, CL_MEM_READ_WRITE);
+        mIntegralCapacity = bytes;
+    }
+
+    mPipeline.createKernel("integral_rows");
+    mPipeline.setKernelArgs(input, mIntegral, width, height);
+    mPipeline.executeLinear(static_cast<size_t>(height) * mScanSize, mScanSize);
+    mPipeline.createKernel("integral_columns");
+    mPipeline.setKernelArgs(mIntegral, width, height);
+    mPipeline.executeLinear(width);
+
+    mIntegralSource = input;
+    return mIntegral.get();
+}
+
+void Engine::invalidateIntegral(cl_mem buffer) {
+    if (buffer == mIntegralSource) mIntegralSource = nullptr;
+}
+
+void Engine::computeStatistics(cl_mem buffer, const int pixels) {
+    if (!mPartials) {
+        mPartials = mPipeline.createBuffer(STATS_GROUPS * sizeof(StatsPartial), CL_MEM_READ_WRITE);
+    }
+
+    // Small images need fewer groups than STATS_GROUPS to give every work-item a pixel
+    const size_t groups = std::clamp<size_t>((pixels + mStatsGroup - 1) / mStatsGroup, 1, STATS_GROUPS);
+    mPipeline.createProgram("stats", CLPipeline::define("STATS_GROUP", mStatsGroup));
+    mPipeline.createKernel("stats_reduce");
+    mPipeline.setKernelArgs(buffer, mPartials, pixels);
+    mPipeline.executeLinear(groups * mStatsGroup, mStatsGroup);
+    mPipeline.createKernel("stats_merge");
+    mPipeline.setKernelArgs(mPartials, static_cast<int>(groups));
+    mPipeline.executeLinear(mStatsGroup, mStatsGroup);
+
+    StatsPartial result{};
+    mPipeline.readBytes(mPartials.get(), &result, sizeof(result));
+
+    for (int c = 0; c < 4; ++c) {
+        ChannelStats& channel = mStatistics[c];
+        channel.sum = result.sum.s[c];
+        channel.min = static_cast<uint8_t>(result.min.s[c]);
+        channel.max = static_cast<uint8_t>(result.max.s[c]);
+        channel.mean = static_cast<double>(channel.sum) / pixels;
+        const double meanSquare = static_cast<double>(result.squares.s[c]) / pixels;
+        channel.stddev = std::sqrt(std::max(meanSquare - channel.mean * channel.mean, 0.0));
+    }
+}
+
+void Engine::computeHistogram(cl_mem input, const int pixels) {
+    static constexpr std::array<cl_uint, 256> empty{};
+    if (!mBins) {
+        mBins = mPipeline.createBuffer(sizeof(empty), CL_MEM_READ_WRITE);
+    }
+    mPipeline.writeBytes(mBins.get(), empty.data(), sizeof(empty));
+
+    // Enough work-groups to fill the device; each merges its bins once, so more would
+    // only add global atomics
+    const size_t groups = std::min<size_t>((pixels + mHistogramGroup - 1) / mHistogramGroup, 128);
+    mPipeline.createProgram("histogram");
+    mPipeline.createKernel("histogram");
+    mPipeline.setKernelArgs(input, mBins, pixels);
+    mPipeline.executeLinear(groups * mHistogramGroup, mHistogramGroup);
+}
+
+void Engine::runBoxes(cl_mem input, cl_mem output, const int width, const int height,
+                      const std::span<const int> radii) {
+    const int passes = static_cast<int>(radii.size());
+    reserveScratch(static_cast<size_t>(width) * height, passes > 1 ? 2 : 1);
+    mPipeline.createProgram("box_blur");
+
+    // Rows start from the pixels, columns end in them; in between the passes
+    // alternate between the two intermediates
+    cl_mem src = input;
+    int next = 0;
+    for (int i = 0; i < passes; ++i) {
+        cl_mem dst = mScratch[next].get();
+        mPipeline.createKernel(i == 0 ? "box_rows" : "box_rows_float");
+        mPipeline.setKernelArgs(src, dst, width, height, radii[i]);
+        mPipeline.executeLinear(height);
+        src = dst;
+        next ^= 1;
+    }
+
+    for (int i = 0; i < passes; ++i) {
+        const bool last = i == passes - 1;
+        cl_mem dst = last ? output : mScratch[next].get();
+        mPipeline.createKernel(last ? "box_columns" : "box_columns_float");
+        mPipeline.setKernelArgs(src, dst, width, height, radii[i]);
+        mPipeline.executeLinear(width);
+        src = dst;
+        next ^= 1;
+    }
+}
+
+void Engine::bindBatchedEffect(const Effect effect) {
+    switch (effect) {
+        case Effect::GAUSSIAN_BLUR:
+            if (mWeights == nullptr) {
+                mWeights = mPipeline.createBuffer(BufferType::KERNEL);
+            }
+            mPipeline.createProgram("gaussian_blur", mBlurOptions);
+            mPipeline.createKernel("gaussian_blur_batched");
+            mPipeline.setKernelArgs(mInput, mOutput, mTable, mWeights);
+            break;
+        case Effect::GRAYSCALE:
+            mPipeline.createProgram("grayscale");
+            mPipeline.createKernel("grayscale_batched");
+            mPipeline.setKernelArgs(mInput, mOutput, mTable);
+            break;
+        case Effect::SEPIA:
+            mPipeline.createProgram("sepia_filter", mPrecisionOptions);
+            mPipeline.createKernel("sepia_filter_batched");
+            mPipeline.setKernelArgs(mInput, mOutput, mTable);
+            break;
+        case Effect::CONVOLVE:
+            if (mConvolution.empty()) {
+                throw std::runtime_error("No convolution matrix set");
+            }
+            if (convolvesWithFft()) {
+                // The batched kernel applies every tap, which is what the transforms avoid
+                throw std::runtime_error("Matrices past the FFT crossover are not available in batches");
+            }
+            mPipeline.createProgram("convolve", mConvolutionOptions);
+            mPipeline.createKernel("convolve_batched");
+            mPipeline.setKernelArgs(mInput, mOutput, mTable, mConvolutionWeights);
+            break;
+        case Effect::BOX_BLUR:
+            mPipeline.createProgram("box_blur");
+            mPipeline.createKernel("box_blur_batched");
+            mPipeline.setKernelArgs(mInput, mOutput, mTable, mBoxRadius);
+            break;
+        case Effect::ADAPTIVE_THRESHOLD:
+            mPipeline.createProgram("integral", CLPipeline::define("SCAN_SIZE", mScanSize));
+            mPipeline.createKernel("adaptive_threshold_batched");
+            mPipeline.setKernelArgs(mInput, mOutput, mTable, mThresholdRadius, mThresholdBias);
+            break;
+        case Effect::BILATERAL:
+            if (mBilateralRadius > BILATERAL_SEPARABLE_RADIUS) {
+                throw std::runtime_error("Batched bilateral supports radii up to " +
+                                         std::to_string(BILATERAL_SEPARABLE_RADIUS));
+            }
+            mPipeline.createProgram("bilateral", mBilateralOptions);
+            mPipeline.createKernel("bilateral_batched");
+            mPipeline.setKernelArgs(mInput, mOutput, mTable, mRangeWeights);
+            break;
+        case Effect::MEDIAN:
+            if (mMedianRadius > MEDIAN_NETWORK_RADIUS) {
+                throw std::runtime_error("Batched median supports radii up to " +
+                                         std::to_string(MEDIAN_NETWORK_RADIUS));
+            }
+            // Same options as the single-image path, so the histogram kernel in the program fits local memory
+            mPipeline.createProgram("median", mMedianOptions);
+            mPipeline.createKernel("median_batched");
+            mPipeline.setKernelArgs(mInput, mOutput, mTable);
+            break;
+        case Effect::SOBEL:
+            mPipeline.createProgram("edges");
+            mPipeline.createKernel("sobel_batched");
+            mPipeline.setKernelArgs(mInput, mOutput, mTable);
+            break;
+        case Effect::CANNY:
+            // Hysteresis runs until convergence, which a single launch per effect cannot do
+            throw std::runtime_error("Canny is not available in batches");
+        case Effect::EQUALISE:
+        case Effect::CLAHE:
+            // Histograms are per image, which needs a launch per image
+            throw std::runtime_error("Equalisation is not available in batches");
+        case Effect::RESIZE:
+            // Images in a batch share their offsets between input and output
+            throw std::runtime_error("Resize is not available in batches");
+    }
+}
+
+bool Engine::supportsBatch(const std::span<const Effect> chain) const {
+    return std::ranges::none_of(chain, [this](const Effect effect) {
+        switch (effect) {
+            case Effect::CANNY:
+            case Effect::EQUALISE:
+            case Effect::CLAHE:
+            case Effect::RESIZE:
+                return true;
+            case Effect::CONVOLVE:
+                return convolvesWithFft();
+            case Effect::BILATERAL:
+                return mBilateralRadius > BILATERAL_SEPARABLE_RADIUS;
+            case Effect::MEDIAN:
+                return mMedianRadius > MEDIAN_NETWORK_RADIUS;
+            default:
+                return false;
+        }
+    });
+}
@@ -0,0 +1,336 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include "clPipeline.h"
+#include "convolution.h"
+#include "fftConvolver.h"
+#include "pinnedAllocator.h"
+#include "resizer.h"
+
+enum class Effect {
+    GAUSSIAN_BLUR, GRAYSCALE, SEPIA, CONVOLVE, BOX_BLUR, ADAPTIVE_THRESHOLD, BILATERAL, MEDIAN, SOBEL, CANNY, EQUALISE, CLAHE, RESIZE
+};
+
+enum class PixelFormat {
+    RGBA8, RGB8, GRAY8
+};
+
+// Arithmetic used by the blur and sepia kernels. FP16 needs cl_khr_fp16; FIXED uses
+// integer weights with FIXED_SHIFT fraction bits. Both give 8-bit output within
+// rounding of FP32.
+enum class Precision {
+    FP32, FP16, FIXED
+};
+
+// How Effect::GAUSSIAN_BLUR is computed: EXACT applies the 5x5 sigma ~1 matrix,
+// APPROX three box blurs matched to any sigma, at a cost independent of it
+enum class BlurMode {
+    EXACT, APPROX
+};
+
+// Statistics of one channel of an image; the standard deviation is the population one
+struct ChannelStats {
+    uint64_t sum{};
+    uint8_t min{};
+    uint8_t max{};
+    double mean{};
+    double stddev{};
+};
+
+// R, G, B and A statistics
+using ImageStats = std::array<ChannelStats, 4>;
+
+// Non-owning view of caller memory. A stride of 0 means tightly packed rows.
+struct PixelBuffer {
+    uint8_t* data{nullptr};
+    int width{};
+    int height{};
+    size_t stride{};
+    PixelFormat format{PixelFormat::RGBA8};
+};
+
+// Long-lived processing engine. Owns the OpenCL context, the compiled kernels and
+// the device buffers, which are reused across calls and only grow when needed.
+// An Engine is not thread-safe; use one per thread or serialise access.
+class Engine {
+public:
+    explicit Engine(DeviceType device = DeviceType::GPU);
+
+    static Effect getEffect(const char* name);
+
+    // Parses a comma separated chain such as "gs,gb"
+    static std::vector<Effect> getEffects(const char* names);
+
+    static int channels(PixelFormat format);
+
+    static Precision getPrecision(const char* name);
+
+    // Throws if the device cannot run the requested precision
+    void setPrecision(Precision precision);
+
+    static BlurMode getBlurMode(const char* name);
+
+    // sigma is used in APPROX mode only. Batches keep the exact blur, as their
+    // images are too small for large radii.
+    void setBlurMode(BlurMode mode, float sigma = 1.0f);
+
+    // Radius of Effect::BOX_BLUR, whose window is 2 * radius + 1 pixels wide
+    void setBoxRadius(int radius);
+
+    // Effect::ADAPTIVE_THRESHOLD turns pixels white whose luma exceeds the mean of the
+    // surrounding (2 * radius + 1)^2 window times 1 - bias, i.e. is at most the bias
+    // fraction below the mean
+    void setThreshold(int radius, float bias);
+
+    // Window radius of Effect::BILATERAL, with spatial sigma radius / 2, and the
+    // sigma of its colour distance weights
+    void setBilateral(int radius, float sigmaRange);
+
+    // Window radius of Effect::MEDIAN, up to 127. Batches support up to MEDIAN_NETWORK_RADIUS.
+    void setMedianRadius(int radius);
+
+    // Gradient magnitudes at which Effect::CANNY keeps weak edges connected to strong
+    // ones, and strong edges unconditionally
+    void setCanny(float low, float high);
+
+    // Effect::CLAHE equalises each tile of a tiles x tiles grid separately, clipping
+    // its histogram at clip times the average bin to limit noise amplification
+    void setClahe(int tiles, float clip);
+
+    // Output size of Effect::RESIZE; 0 for one side keeps the aspect ratio
+    void setResize(int width, int height, ResizeFilter filter);
+
+    // Size of the image chain produces from a width x height input; process() expects dst of this size
+    [[nodiscard]] std::pair<int, int> outputSize(std::span<const Effect> chain, int width, int height) const;
+
+    // Whether processBatch can run chain, which needs a single-launch kernel for every effect
+    [[nodiscard]] bool supportsBatch(std::span<const Effect> chain) const;
+
+    // Luma histogram of src, computed on the device; only the 256 bins are read back
+    std::array<uint32_t, 256> histogram(const PixelBuffer& src);
+
+    // When enabled, process() reduces every output on the device before it is
+    // downloaded; statistics() then describes the last one. Batches are not covered.
+    void setStatistics(bool enabled) { mStatisticsEnabled = enabled; }
+
+    [[nodiscard]] const ImageStats& statistics() const { return mStatistics; }
+
+    void process(Effect effect, const PixelBuffer& src, const PixelBuffer& dst);
+
+    // Applies the effects in order, keeping intermediates on the device
+    void process(std::span<const Effect> chain, const PixelBuffer& src, const PixelBuffer& dst);
+
+    // Applies each effect on its own to src, into dsts[i], uploading src once. Effects
+    // that read window sums (box, thr) share one summed-area table of src.
+    void processEach(std::span<const Effect> effects, const PixelBuffer& src, std::span<const PixelBuffer> dsts);
+
+    // Runs the chain into levels[0], then halves it into each following level with the
+    // resize filter, every level resampled on the device from the one before. Level i
+    // must be nextLevel() of level i - 1; statistics, when enabled, cover levels[0].
+    void pyramid(std::span<const Effect> chain, const PixelBuffer& src, std::span<const PixelBuffer> levels);
+
+    // Size of the pyramid level below a width x height one, rounded up
+    [[nodiscard]] static std::pair<int, int> nextLevel(int width, int height);
+
+    // Packs the images into one device buffer and runs each effect with a single
+    // launch for the whole batch. Meant for small images, where launch and transfer
+    // overhead outweighs the work; srcs[i] is processed into dsts[i].
+    void processBatch(std::span<const Effect> chain, std::span<const PixelBuffer> srcs,
+                      std::span<const PixelBuffer> dsts);
+
+    // Matrix applied by Effect::CONVOLVE
+    void setConvolution(Convolution convolution);
+
+    // Matrices with more taps than this are applied through FFTs; see FftConvolver
+    void setFftCrossover(size_t taps) { mFftCrossover = taps; }
+
+    // Times direct against FFT convolution at a few matrix sizes on this device and sets
+    // the crossover to where FFTs start winning. Results are cached per device under the
+    // user's cache directory, so only the first run on a device pays for the measurement.
+    size_t calibrateFftCrossover();
+
+    // Bakes the frame size into the kernels so the compiler can fold the index math.
+    // Every distinct size builds its own programs, so this pays off for fixed-size
+    // streams such as video frames, not for batches of assorted images.
+    void setSpecialised(bool enabled) { mSpecialised = enabled; }
+
+    // Memory to decode inputs into so that process() can hand them to the device
+    // without a staging copy. Such images are consumed by process(); see PinnedAllocator.
+    ImageAllocator& hostAllocator() { return mPinned; }
+
+    void printProfilingInfo() const { mPipeline.printProfilingInfo(); }
+
+    // Images up to this many pixels benefit from processBatch
+    static constexpr size_t BATCH_MAX_PIXELS = 100000;
+
+    // Fraction bits of the fixed-point weights, matching the kernels
+    static constexpr int FIXED_SHIFT = 14;
+
+    // Bilateral filters of larger radii run as a row and a column pass
+    static constexpr int BILATERAL_SEPARABLE_RADIUS = 5;
+
+    // Median windows up to this radius are sorted in registers, larger ones through histograms
+    static constexpr int MEDIAN_NETWORK_RADIUS = 2;
+    // Fewest rows per work-group of the histogram median, which sets up column histograms
+    // across the whole width for every strip
+    static constexpr int MEDIAN_STRIP_ROWS = 64;
+
+    // Work-groups of the first reduction pass; the second pass merges their results
+    static constexpr size_t STATS_GROUPS = 64;
+
+    // Canny hysteresis passes between checks for convergence, each check being a sync
+    static constexpr int HYSTERESIS_PASSES = 4;
+
+    // Default for setFftCrossover until calibrated, roughly where FFTs overtake a tiled 31x31 matrix
+    static constexpr size_t FFT_CROSSOVER = 31 * 31;
+
+private:
+    // dst must be width x height
+    static void validate(const PixelBuffer& src, const PixelBuffer& dst, int width, int height);
+
+    // Converts between caller layouts and the packed RGBA consumed by the kernels
+    static void pack(const PixelBuffer& src, uint8_t* rgba);
+
+    static void unpack(const uint8_t* rgba, const PixelBuffer& dst);
+
+    static bool isPackedRGBA(const PixelBuffer& buffer);
+
+    void reserve(size_t pixels);
+
+    void reserveImage(int width, int height);
+
+    // Grows the first count float4 intermediates to hold pixels each
+    void reserveScratch(size_t pixels, int count = 1);
+
+    // Returns the device buffer holding src, which is mInput unless src is pinned
+    cl_mem upload(const PixelBuffer& src);
+
+    void download(const PixelBuffer& dst);
+
+    // Uploads src and applies chain; the result ends up in mOutput
+    void runChain(std::span<const Effect> chain, const PixelBuffer& src);
+
+    // Whether Effect::CONVOLVE runs the current matrix through FftConvolver
+    [[nodiscard]] bool convolvesWithFft() const;
+
+    // Seconds a single-image CONVOLVE of width x height pixels takes, kernels built beforehand
+    double timeConvolution(cl_mem input, cl_mem output, int width, int height);
+
+    // Output size of Effect::RESIZE for a width x height input
+    [[nodiscard]] std::pair<int, int> resizedSize(int width, int height) const;
+
+    // Binds and launches one effect of a chain; output is sized for the effect's result
+    void runEffect(Effect effect, cl_mem input, cl_mem output, int width, int height);
+
+    // Summed-area table of the width x height pixels in input, in mIntegral. Built once
+    // per input: box and thr reading the same buffer share it until the buffer is written.
+    cl_mem integral(cl_mem input, int width, int height);
+
+    // Called for every buffer about to be overwritten, dropping its summed-area table
+    void invalidateIntegral(cl_mem buffer);
+
+    // Per-channel statistics of the pixels in buffer into mStatistics
+    void computeStatistics(cl_mem buffer, int pixels);
+
+    // Luma histogram of input into mBins
+    void computeHistogram(cl_mem input, int pixels);
+
+    // Successive box blurs with the given radii, rows first, then columns
+    void runBoxes(cl_mem input, cl_mem output, int width, int height, std::span<const int> radii);
+
+    void bindBatchedEffect(Effect effect);
+
+    // Three box radii whose successive blurs approximate a Gaussian of sigma
+    static std::array<int, 3> boxRadii(float sigma);
+
+    CLPipeline mPipeline;
+    DeviceType mDevice;
+    PinnedAllocator mPinned{mPipeline};
+    CLMem mInput;
+    CLMem mOutput;
+    cl_mem mWeights{nullptr};
+    CLMem mTable;
+    // Sampled copy of the input for neighbourhood filters, when the device has images
+    CLMem mImage;
+    int mImageWidth{};
+    int mImageHeight{};
+    bool mSpecialised{false};
+    Precision mPrecision{Precision::FP32};
+    std::string mPrecisionOptions;
+    // Work-group side of the tiled blur, fixed when its program is built
+    size_t mTileSize{};
+    // Build options fixing the blur precision, tile, radius and weights
+    std::string mBlurOptions;
+    Convolution mConvolution;
+    // Full matrix, then the row and column factors when separable
+    CLMem mConvolutionWeights;
+    std::string mConvolutionOptions;
+    FftConvolver mFft{mPipeline};
+    size_t mFftCrossover{FFT_CROSSOVER};
+    // float4 intermediates of multi-pass filters; the second only for filters that ping-pong
+    CLMem mScratch[2];
+    size_t mScratchCapacity[2]{};
+    BlurMode mBlurMode{BlurMode::EXACT};
+    std::array<int, 3> mApproxRadii{};
+    int mBoxRadius{2};
+    int mThresholdRadius{7};
+    float mThresholdBias{0.15f};
+    int mBilateralRadius{};
+    // Build options with the full and the separable spatial weights
+    std::string mBilateralOptions;
+    std::string mBilateralSeparableOptions;
+    // Range weights by rounded RGB distance
+    CLMem mRangeWeights;
+    int mMedianRadius{1};
+    // Work-group size of the histogram median, which spreads the 256 bins over it
+    size_t mMedianGroup{};
+    // Build options of every median program, single-image and batched alike
+    std::string mMedianOptions;
+    float mCannyLow{50.0f};
+    float mCannyHigh{100.0f};
+    // Set by hysteresis passes that promoted a pixel
+    CLMem mChanged;
+    int mClaheTiles{8};
+    float mClaheClip{2.0f};
+    // 256 luma bins, the global equalisation table and one table per CLAHE tile
+    CLMem mBins;
+    CLMem mLut;
+    CLMem mTileLuts;
+    size_t mTileLutCapacity{};
+    // Work-group size of the histogram kernels
+    size_t mHistogramGroup{};
+    Resizer mResizer{mPipeline};
+    int mResizeWidth{};
+    int mResizeHeight{};
+    bool mStatisticsEnabled{false};
+    ImageStats mStatistics{};
+    // One partial result per reducing work-group
+    CLMem mPartials;
+    // Work-group size of the reductions
+    size_t mStatsGroup{};
+    // Summed-area table, of 32-bit or, for images that could overflow them, 64-bit sums
+    CLMem mIntegral;
+    size_t mIntegralCapacity{};
+    // Buffer mIntegral was built from, if it still holds those pixels
+    cl_mem mIntegralSource{nullptr};
+    // Work-group size of the row scan
+    size_t mScanSize{};
+    // vload16 groups per work-item for point filters; 0 keeps the 2D kernels
+    int mVectors{};
+    size_t mCapacity{};
+    size_t mTableCapacity{};
+    std::vector<cl_int4> mEntries;
+    // Host side repacking for strided or non-RGBA buffers. Uploads are non-blocking, so
+    // downloads repack through their own vector rather than resizing one a write may still read.
+    std::vector<uint8_t> mUploadStaging;
+    std::vector<uint8_t> mDownloadStaging;
+};
+
+#endif //ENGINE_H
@@ -0,0 +1,47 @@
+#include "fft.h"
+#include <cmath>
+#include <numbers>
+#include <utility>
+
+namespace fft {
+void transform(std::complex<float>* data, const size_t n, const size_t stride, const bool inverse) {
+    auto at = [&](const size_t i) -> std::complex<float>& { return data[i * stride]; };
+
+    // Bit-reversal permutation, then iterative butterflies
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+
+        if (i < j) std::swap(at(i), at(j));
+    }
+
+    for (size_t length = 2; length <= n; length <<= 1) {
+        const double angle = (inverse ? 2 : -2) * std::numbers::pi / static_cast<double>(length);
+
+        for (size_t k = 0; k < length / 2; ++k) {
+            const std::complex<float> twiddle(static_cast<float>(std::cos(angle * k)),
+                                              static_cast<float>(std::sin(angle * k)));
+
+            for (size_t i = k; i < n; i += length) {
+                const std::complex<float> even = at(i);
+                const std::complex<float> odd = at(i + length / 2) * twiddle;
+                at(i) = even + odd;
+                at(i + length / 2) = even - odd;
+            }
+        }
+    }
+}
+
+void transform2d(std::complex<float>* data, const size_t width, const size_t height, const bool inverse) {
+    for (size_t y = 0; y < height; ++y) {
+        transform(data + y * width, width, 1, inverse);
+    }
+
+    for (size_t x = 0; x < width; ++x) {
+        transform(data + x, height, width, inverse);
+    }
+}
+}
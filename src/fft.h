@@ -0,0 +1,18 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+// Radix-2 FFTs on the host; sizes must be powers of two. Used for matrix spectra and
+// as the fallback of FftConvolver when the device cannot hold the padded planes.
+namespace fft {
+// In place over n elements spaced stride apart. The inverse is unscaled.
+void transform(std::complex<float>* data, size_t n, size_t stride, bool inverse);
+
+// Row-major width x height plane, rows then columns
+void transform2d(std::complex<float>* data, size_t width, size_t height, bool inverse);
+}
+
+#endif //FFT_H
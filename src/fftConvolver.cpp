@@ -0,0 +1,157 @@
+#include "fftConvolver.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include "fft.h"
+
+FftConvolver::FftConvolver(CLPipeline& pipeline) : mPipeline(pipeline) {}
+
+void FftConvolver::setMatrix(Convolution convolution) {
+    mConvolution = std::move(convolution);
+    mSpectrum.reset();
+    mSpectrumWidth = mSpectrumHeight = 0;
+}
+
+void FftConvolver::run(cl_mem input, cl_mem output, const int width, const int height) {
+    if (mConvolution.empty()) {
+        throw std::runtime_error("No convolution matrix set");
+    }
+
+    const int anchorX = mConvolution.width() / 2;
+    const int anchorY = mConvolution.height() / 2;
+    const size_t paddedWidth = std::bit_ceil(static_cast<size_t>(width + mConvolution.width() - 1));
+    const size_t paddedHeight = std::bit_ceil(static_cast<size_t>(height + mConvolution.height() - 1));
+    const size_t planeSize = paddedWidth * paddedHeight;
+
+    if (3 * planeSize * sizeof(cl_float2) > mPipeline.maxAllocSize()) {
+        const size_t bytes = static_cast<size_t>(width) * height * 4;
+        mHost.resize(2 * bytes);
+        mPipeline.readBuffer(input, mHost.data(), width, height);
+        convolve(mHost.data(), mHost.data() + bytes, width, height, mConvolution);
+        // The queue is in order, so mHost is not touched again before this write completes
+        mPipeline.writeBuffer(output, mHost.data() + bytes, width, height, 4);
+        return;
+    }
+
+    if (planeSize > mPlaneCapacity) {
+        mPlanes = mPipeline.createBuffer(3 * planeSize * sizeof(cl_float2), CL_MEM_READ_WRITE);
+        mWork = mPipeline.createBuffer(3 * planeSize * sizeof(cl_float2), CL_MEM_READ_WRITE);
+        mPlaneCapacity = planeSize;
+    }
+
+    if (paddedWidth != mSpectrumWidth || paddedHeight != mSpectrumHeight) {
+        std::vector<std::complex<float>> host = spectrum(mConvolution, paddedWidth, paddedHeight);
+        mSpectrum = mPipeline.createBuffer(planeSize * sizeof(cl_float2), CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                           host.data());
+        mSpectrumWidth = paddedWidth;
+        mSpectrumHeight = paddedHeight;
+    }
+
+    const int pw = static_cast<int>(paddedWidth);
+    const int ph = static_cast<int>(paddedHeight);
+
+    mPipeline.createProgram("fft");
+    mPipeline.createKernel("fft_pad");
+    mPipeline.setKernelArgs(input, mPlanes, width, height, pw, ph, anchorX, anchorY);
+    mPipeline.execute(pw, ph);
+
+    cl_mem planes = transform(pw, ph, -1.0f);
+    if (planes != mPlanes.get()) std::swap(mPlanes, mWork);
+
+    mPipeline.createKernel("fft_multiply");
+    mPipeline.setKernelArgs(mPlanes, mSpectrum, static_cast<int>(planeSize));
+    mPipeline.executeLinear(3 * planeSize);
+
+    planes = transform(pw, ph, 1.0f);
+
+    mPipeline.createKernel("fft_unpack");
+    mPipeline.setKernelArgs(planes, output, width, height, pw, ph, anchorX, anchorY,
+                            1.0f / static_cast<float>(planeSize));
+    mPipeline.execute(width, height);
+}
+
+cl_mem FftConvolver::transform(const int paddedWidth, const int paddedHeight, const float sign) {
+    cl_mem src = mPlanes.get();
+    cl_mem dst = mWork.get();
+    const int planeSize = paddedWidth * paddedHeight;
+
+    mPipeline.createKernel("fft_radix2");
+
+    // Rows: elements adjacent, one line per row
+    for (int p = 1; p < paddedWidth; p <<= 1) {
+        mPipeline.setKernelArgs(src, dst, paddedWidth, paddedHeight, p, sign, 1, paddedWidth, planeSize);
+        mPipeline.executeBatch(paddedWidth / 2, paddedHeight, 3);
+        std::swap(src, dst);
+    }
+
+    // Columns: elements a row apart, one line per column
+    for (int p = 1; p < paddedHeight; p <<= 1) {
+        mPipeline.setKernelArgs(src, dst, paddedHeight, paddedWidth, p, sign, paddedWidth, 1, planeSize);
+        mPipeline.executeBatch(paddedHeight / 2, paddedWidth, 3);
+        std::swap(src, dst);
+    }
+
+    return src;
+}
+
+void FftConvolver::convolve(const uint8_t* input, uint8_t* output, const int width, const int height,
+                            const Convolution& convolution) {
+    const int anchorX = convolution.width() / 2;
+    const int anchorY = convolution.height() / 2;
+    const size_t paddedWidth = std::bit_ceil(static_cast<size_t>(width + convolution.width() - 1));
+    const size_t paddedHeight = std::bit_ceil(static_cast<size_t>(height + convolution.height() - 1));
+    const size_t planeSize = paddedWidth * paddedHeight;
+
+    const std::vector<std::complex<float>> kernel = spectrum(convolution, paddedWidth, paddedHeight);
+    std::vector<std::complex<float>> plane(planeSize);
+
+    for (int channel = 0; channel < 3; ++channel) {
+        for (size_t y = 0; y < paddedHeight; ++y) {
+            const int iy = std::clamp(static_cast<int>(y) - anchorY, 0, height - 1);
+            for (size_t x = 0; x < paddedWidth; ++x) {
+                const int ix = std::clamp(static_cast<int>(x) - anchorX, 0, width - 1);
+                plane[y * paddedWidth + x] = input[(static_cast<size_t>(iy) * width + ix) * 4 + channel];
+            }
+        }
+
+        fft::transform2d(plane.data(), paddedWidth, paddedHeight, false);
+        for (size_t i = 0; i < planeSize; ++i) {
+            plane[i] *= kernel[i];
+        }
+        fft::transform2d(plane.data(), paddedWidth, paddedHeight, true);
+
+        const float scale = 1.0f / static_cast<float>(planeSize);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const float value = plane[(y + anchorY) * paddedWidth + x + anchorX].real() * scale;
+                output[(static_cast<size_t>(y) * width + x) * 4 + channel] =
+                        static_cast<uint8_t>(std::clamp(std::nearbyint(value), 0.0f, 255.0f));
+            }
+        }
+    }
+
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+        output[i * 4 + 3] = 255;
+    }
+}
+
+std::vector<std::complex<float>> FftConvolver::spectrum(const Convolution& convolution, const size_t paddedWidth,
+                                                        const size_t paddedHeight) {
+    const int anchorX = convolution.width() / 2;
+    const int anchorY = convolution.height() / 2;
+    std::vector<std::complex<float>> plane(paddedWidth * paddedHeight);
+
+    // Weight (kx, ky) goes to (anchor - k) modulo the padded size
+    for (int ky = 0; ky < convolution.height(); ++ky) {
+        const size_t y = (anchorY - ky + paddedHeight) % paddedHeight;
+        for (int kx = 0; kx < convolution.width(); ++kx) {
+            const size_t x = (anchorX - kx + paddedWidth) % paddedWidth;
+            plane[y * paddedWidth + x] = convolution.weights()[ky * convolution.width() + kx];
+        }
+    }
+
+    fft::transform2d(plane.data(), paddedWidth, paddedHeight, false);
+    return plane;
+}
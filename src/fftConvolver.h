@@ -0,0 +1,52 @@
+#ifndef FFTCONVOLVER_H
+#define FFTCONVOLVER_H
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "clPipeline.h"
+#include "convolution.h"
+
+// Convolution through the frequency domain, for matrices large enough that the
+// direct kernels' cost per pixel (one tap per weight) dominates. Images are padded
+// to powers of two with replicated edges, which makes the circular convolution
+// equal to the direct one with clamped borders. Runs radix-2 passes on the device,
+// or on the host when the padded planes exceed the device's allocation limit.
+class FftConvolver {
+public:
+    explicit FftConvolver(CLPipeline& pipeline);
+
+    void setMatrix(Convolution convolution);
+
+    // input and output hold width x height packed RGBA pixels on the device
+    void run(cl_mem input, cl_mem output, int width, int height);
+
+    // Host implementation over packed RGBA memory
+    static void convolve(const uint8_t* input, uint8_t* output, int width, int height,
+                         const Convolution& convolution);
+
+private:
+    // Transform of the flipped, wrapped matrix, so the product computes correlation like convolve.cl
+    static std::vector<std::complex<float>> spectrum(const Convolution& convolution, size_t paddedWidth,
+                                                     size_t paddedHeight);
+
+    // 2D transform of the three planes in mPlanes, using mWork between passes;
+    // returns the buffer holding the result
+    cl_mem transform(int paddedWidth, int paddedHeight, float sign);
+
+    CLPipeline& mPipeline;
+    Convolution mConvolution;
+
+    CLMem mPlanes;
+    CLMem mWork;
+    size_t mPlaneCapacity{};
+    // Matrix spectrum for the padded size it was computed for
+    CLMem mSpectrum;
+    size_t mSpectrumWidth{};
+    size_t mSpectrumHeight{};
+    // Host fallback input and output
+    std::vector<uint8_t> mHost;
+};
+
+#endif //FFTCONVOLVER_H
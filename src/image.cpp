@@ -1,23 +1,134 @@
 #include "image.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <utility>
+#ifdef PIXCL_HAS_LIBJPEG
+#include "jpegDecoder.h"
+#endif
+
+namespace {
+
+// While set, the first stb allocation of exactly the decoded image's size is served
+// from caller memory, so the decoder writes its output there instead of into a
+// buffer of its own that would then have to be copied
+struct DecodeTarget {
+    uint8_t* data;
+    size_t size;
+    bool inUse;
+};
+
+thread_local DecodeTarget* decodeTarget = nullptr;
+
+void* decodeMalloc(const size_t size) {
+    // The JPEG decoder asks for one spare byte that it never writes
+    if (DecodeTarget* target = decodeTarget;
+        target && !target->inUse && (size == target->size || size == target->size + 1)) {
+        target->inUse = true;
+        return target->data;
+    }
+
+    return std::malloc(size);
+}
+
+void decodeFree(void* ptr) {
+    if (DecodeTarget* target = decodeTarget; target && ptr == target->data) {
+        target->inUse = false;
+        return;
+    }
+
+    std::free(ptr);
+}
+
+void* decodeRealloc(void* ptr, const size_t oldSize, const size_t size) {
+    // Caller memory cannot grow, move the contents to the heap
+    if (DecodeTarget* target = decodeTarget; target && ptr == target->data) {
+        void* moved = std::malloc(size);
+        if (moved != nullptr) {
+            std::memcpy(moved, ptr, std::min(oldSize, size));
+            target->inUse = false;
+        }
+        return moved;
+    }
+
+    return std::realloc(ptr, size);
+}
+}
+
+#define STBI_MALLOC(size) decodeMalloc(size)
+#define STBI_REALLOC_SIZED(ptr, oldSize, size) decodeRealloc(ptr, oldSize, size)
+#define STBI_FREE(ptr) decodeFree(ptr)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
+#include "poolAllocator.h"
+#ifdef PIXCL_HAS_ZLIB
+#include "pngEncoder.h"
+#endif
 
-Image::~Image() {
-    if (mRaw == nullptr) return;
+namespace {
 
-    switch (mAllocType) {
-        case AllocationType::STB_ALLOCATED:
-            stbi_image_free(mRaw);
-            break;
-        case AllocationType::CUSTOM_ALLOCATED:
-            delete[] mRaw;
-            break;
+class HeapAllocator final : public ImageAllocator {
+public:
+    uint8_t* allocate(const size_t size) override { return new uint8_t[size]; }
+
+    void deallocate(uint8_t* ptr, size_t) override { delete[] ptr; }
+};
+
+// Owns buffers returned by stbi_load
+class StbAllocator final : public ImageAllocator {
+public:
+    uint8_t* allocate(size_t) override { throw std::logic_error("stb buffers come from the decoder"); }
+
+    void deallocate(uint8_t* ptr, size_t) override { stbi_image_free(ptr); }
+
+    static ImageAllocator& instance() {
+        static StbAllocator allocator;
+        return allocator;
     }
+};
+}
+
+ImageAllocator& ImageAllocator::heap() {
+    static HeapAllocator allocator;
+    return allocator;
+}
+
+ImageAllocator& ImageAllocator::pool() {
+    return PoolAllocator::instance();
+}
+
+Image::~Image() {
+    release();
+}
+
+Image::Image(Image&& other) noexcept {
+    *this = std::move(other);
+}
+
+Image& Image::operator=(Image&& other) noexcept {
+    if (this == &other) return *this;
+
+    release();
+    mWidth = other.mWidth;
+    mHeight = other.mHeight;
+    mChannels = other.mChannels;
+    mSize = other.mSize;
+    mFormat = other.mFormat;
+    mAllocator = other.mAllocator;
+    mRaw = std::exchange(other.mRaw, nullptr);
+
+    return *this;
+}
+
+void Image::release() {
+    if (mRaw == nullptr) return;
 
+    mAllocator->deallocate(mRaw, mSize);
     mRaw = nullptr;
 }
 
@@ -33,46 +144,183 @@ ImageFormat Image::getFormat(const char* name) {
                                 : ImageFormat::RAW;
 }
 
+bool Image::info(const char* name, int& width, int& height) {
+    int channels;
+    return stbi_info(name, &width, &height, &channels) != 0;
+}
+
 void Image::load(const char* name) {
+    release();
     mRaw = stbi_load(name, &mWidth, &mHeight, &mChannels, STBI_rgb_alpha);
 
     if (mRaw == nullptr) {
         throw std::runtime_error("Failed to load image");
     }
 
-    mSize = mWidth * mHeight * mChannels;
-    mAllocType = AllocationType::STB_ALLOCATED;
+    // Decoded as RGBA whatever the file holds
+    mChannels = STBI_rgb_alpha;
+    mSize = static_cast<size_t>(mWidth) * mHeight * mChannels;
+    mAllocator = &StbAllocator::instance();
+}
+
+void Image::load(const uint8_t* data, const size_t size) {
+    release();
+    mRaw = stbi_load_from_memory(data, static_cast<int>(size), &mWidth, &mHeight, &mChannels, STBI_rgb_alpha);
+
+    if (mRaw == nullptr) {
+        throw std::runtime_error("Failed to decode image");
+    }
+
+    // Decoded as RGBA whatever the file holds
+    mChannels = STBI_rgb_alpha;
+    mSize = static_cast<size_t>(mWidth) * mHeight * mChannels;
+    mAllocator = &StbAllocator::instance();
+}
+
+void Image::load(const char* name, ImageAllocator& allocator, const DecodeOptions& options) {
+    if (decodeJpeg(options, allocator, name)) return;
+
+    int width, height, channels;
+    if (!stbi_info(name, &width, &height, &channels)) {
+        throw std::runtime_error("Failed to load image");
+    }
+
+    decode(width, height, allocator, [&](int* w, int* h, int* c) {
+        return stbi_load(name, w, h, c, STBI_rgb_alpha);
+    });
+}
+
+void Image::load(const uint8_t* data, const size_t size, ImageAllocator& allocator, const DecodeOptions& options) {
+    if (decodeJpeg(options, allocator, data, size)) return;
+
+    int width, height, channels;
+    if (!stbi_info_from_memory(data, static_cast<int>(size), &width, &height, &channels)) {
+        throw std::runtime_error("Failed to decode image");
+    }
+
+    decode(width, height, allocator, [&](int* w, int* h, int* c) {
+        return stbi_load_from_memory(data, static_cast<int>(size), w, h, c, STBI_rgb_alpha);
+    });
+}
+
+template<typename Decode>
+void Image::decode(const int width, const int height, ImageAllocator& allocator, Decode&& decode) {
+    release();
+
+    const size_t size = static_cast<size_t>(width) * height * STBI_rgb_alpha;
+    uint8_t* pixels = allocator.allocate(size);
+
+    DecodeTarget target{pixels, size, false};
+    decodeTarget = &target;
+    uint8_t* decoded = decode(&mWidth, &mHeight, &mChannels);
+    decodeTarget = nullptr;
+
+    if (decoded == nullptr) {
+        allocator.deallocate(pixels, size);
+        throw std::runtime_error("Failed to decode image");
+    }
+
+    // Formats that convert through an intermediate of the same size land elsewhere
+    if (decoded != pixels) {
+        std::memcpy(pixels, decoded, size);
+        stbi_image_free(decoded);
+    }
+
+    mRaw = pixels;
+    mChannels = STBI_rgb_alpha;
+    mSize = size;
+    mAllocator = &allocator;
 }
 
-void Image::create(const int width, const int height, const int channels, const ImageFormat format) {
+template<typename... Source>
+bool Image::decodeJpeg(const DecodeOptions& options, ImageAllocator& allocator, Source... source) {
+#ifdef PIXCL_HAS_LIBJPEG
+    if (options.minWidth <= 0 && options.minHeight <= 0) return false;
+
+    JpegDecoder jpeg(source...);
+    if (!jpeg.readHeader()) return false;
+    jpeg.scale(options.minWidth, options.minHeight);
+
+    release();
+    const size_t size = static_cast<size_t>(jpeg.width()) * jpeg.height() * STBI_rgb_alpha;
+    uint8_t* pixels = allocator.allocate(size);
+    try {
+        jpeg.decode(pixels);
+    } catch (...) {
+        allocator.deallocate(pixels, size);
+        throw;
+    }
+
+    mRaw = pixels;
+    mWidth = jpeg.width();
+    mHeight = jpeg.height();
+    mChannels = STBI_rgb_alpha;
+    mSize = size;
+    mAllocator = &allocator;
+    return true;
+#else
+    // stb cannot decode scaled; the resize that follows does all the work
+    (void) options;
+    (void) allocator;
+    ((void) source, ...);
+    return false;
+#endif
+}
+
+void Image::create(const int width, const int height, const int channels, const ImageFormat format,
+                   ImageAllocator& allocator) {
+    release();
     mWidth = width;
     mHeight = height;
     mChannels = channels;
     mFormat = format;
-    mAllocType = AllocationType::CUSTOM_ALLOCATED;
-    mSize = mWidth * mHeight * mChannels;
-    mRaw = new uint8_t[mSize];
+    mAllocator = &allocator;
+    mSize = static_cast<size_t>(mWidth) * mHeight * mChannels;
+    mRaw = mAllocator->allocate(mSize);
+}
+
+void Image::write(const char* name, const EncodeOptions& options) const {
+    const std::vector<uint8_t> bytes = encode(options);
+
+    std::ofstream outfile(name, std::ios::binary);
+    if (!outfile.is_open()) {
+        throw std::runtime_error("Could not open " + std::string(name));
+    }
+
+    outfile.write(reinterpret_cast<const char*>(bytes.data()), static_cast<long>(bytes.size()));
+    outfile.close();
 }
 
-void Image::write(const char* name, const int quality) const {
+std::vector<uint8_t> Image::encode(const EncodeOptions& options) const {
+    std::vector<uint8_t> bytes;
+    auto append = [](void* context, void* data, const int size) {
+        auto* out = static_cast<std::vector<uint8_t>*>(context);
+        out->insert(out->end(), static_cast<uint8_t*>(data), static_cast<uint8_t*>(data) + size);
+    };
+
     switch (mFormat) {
         case ImageFormat::JPG:
-            stbi_write_jpg(name, mWidth, mHeight, mChannels, mRaw, quality);
+            stbi_write_jpg_to_func(append, &bytes, mWidth, mHeight, mChannels, mRaw, options.quality);
             break;
         case ImageFormat::PNG:
-            stbi_write_png(name, mWidth, mHeight, mChannels, mRaw, mWidth * mChannels);
+#ifdef PIXCL_HAS_ZLIB
+            bytes = PngEncoder::encode(mRaw, mWidth, mHeight, mChannels, options.pngLevel, options.threads);
+#else
+            // Process-wide in stb; every writer sets it before encoding
+            stbi_write_png_compression_level = options.pngLevel;
+            stbi_write_png_to_func(append, &bytes, mWidth, mHeight, mChannels, mRaw, mWidth * mChannels);
+#endif
             break;
         case ImageFormat::BMP:
-            stbi_write_bmp(name, mWidth, mHeight, mChannels, mRaw);
+            stbi_write_bmp_to_func(append, &bytes, mWidth, mHeight, mChannels, mRaw);
             break;
         case ImageFormat::TGA:
-            stbi_write_tga(name, mWidth, mHeight, mChannels, mRaw);
+            stbi_write_tga_to_func(append, &bytes, mWidth, mHeight, mChannels, mRaw);
             break;
-        case ImageFormat::RAW: {
-            std::ofstream outfile(name, std::ios::binary);
-            outfile.write(reinterpret_cast<const char*>(mRaw), static_cast<long>(mSize));
-            outfile.close();
+        case ImageFormat::RAW:
+            bytes.assign(mRaw, mRaw + mSize);
             break;
-        }
     }
+
+    return bytes;
 }
@@ -1,23 +1,58 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <cstdint>
 #include <cstdlib>
+#include <vector>
 
 enum class ImageFormat {
     JPG, PNG, BMP, TGA, RAW
 };
 
-enum class AllocationType {
-    STB_ALLOCATED,
-    CUSTOM_ALLOCATED
+struct EncodeOptions {
+    int quality{100};   // jpg
+    int pngLevel{8};    // png, 0-9
+    int threads{1};     // png, used when built with zlib
 };
 
+struct DecodeOptions {
+    // JPEGs may decode reduced by 1/2, 1/4 or 1/8 while staying at least this large;
+    // 0 for both decodes at full size. Needs libjpeg.
+    int minWidth{};
+    int minHeight{};
+};
+
+// Source of pixel memory for Image::create; every Image returns its pixels to the allocator they came from
+class ImageAllocator {
+public:
+    virtual ~ImageAllocator() = default;
+
+    virtual uint8_t* allocate(size_t size) = 0;
+
+    virtual void deallocate(uint8_t* ptr, size_t size) = 0;
+
+    // Plain new[]/delete[]
+    static ImageAllocator& heap();
+
+    // The page-aligned, pooled allocator used by default
+    static ImageAllocator& pool();
+};
+
+// Owns its pixels; move-only so buffers can be handed between pipeline stages without copies
 class Image {
 public:
     Image() = default;
 
     ~Image();
 
+    Image(const Image&) = delete;
+
+    Image& operator=(const Image&) = delete;
+
+    Image(Image&& other) noexcept;
+
+    Image& operator=(Image&& other) noexcept;
+
     static ImageFormat getFormat(const char* name);
 
     [[nodiscard]] int width() const { return mWidth; }
@@ -30,19 +65,42 @@ public:
 
     [[nodiscard]] uint8_t* raw() const { return mRaw; }
 
+    // Size of an image file from its header, without decoding; false if it is not readable
+    static bool info(const char* name, int& width, int& height);
+
     void load(const char* name);
 
-    void create(int width, int height, int channels, ImageFormat format);
+    void load(const uint8_t* data, size_t size);
+
+    // Decode straight into memory from the allocator, e.g. a mapped device buffer
+    void load(const char* name, ImageAllocator& allocator, const DecodeOptions& options = {});
+
+    void load(const uint8_t* data, size_t size, ImageAllocator& allocator, const DecodeOptions& options = {});
 
-    void write(const char* name, int quality = 100) const;
+    void create(int width, int height, int channels, ImageFormat format,
+                ImageAllocator& allocator = ImageAllocator::pool());
+
+    void write(const char* name, const EncodeOptions& options = {}) const;
+
+    // Encodes into memory instead of a file
+    [[nodiscard]] std::vector<uint8_t> encode(const EncodeOptions& options = {}) const;
 
 private:
+    void release();
+
+    template<typename Decode>
+    void decode(int width, int height, ImageAllocator& allocator, Decode&& decode);
+
+    // Scaled decode through libjpeg; false when the file is not one it handles
+    template<typename... Source>
+    bool decodeJpeg(const DecodeOptions& options, ImageAllocator& allocator, Source... source);
+
     int mWidth{};
     int mHeight{};
     int mChannels{};
     size_t mSize{};
     ImageFormat mFormat{};
-    AllocationType mAllocType{};
+    ImageAllocator* mAllocator{nullptr};
     uint8_t* mRaw{nullptr};
 };
 
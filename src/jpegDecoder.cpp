@@ -0,0 +1,98 @@
+#include "jpegDecoder.h"
+#include <stdexcept>
+
+JpegDecoder::JpegDecoder(const char* name) {
+    mInfo.err = jpeg_std_error(&mError.manager);
+    mError.manager.error_exit = exit;
+    // Files libjpeg rejects fall back to stb, so its warnings would only be noise
+    mError.manager.output_message = [](j_common_ptr) {};
+    jpeg_create_decompress(&mInfo);
+
+    mFile = std::fopen(name, "rb");
+    if (mFile != nullptr) {
+        jpeg_stdio_src(&mInfo, mFile);
+    }
+}
+
+JpegDecoder::JpegDecoder(const uint8_t* data, const size_t size) {
+    mInfo.err = jpeg_std_error(&mError.manager);
+    mError.manager.error_exit = exit;
+    mError.manager.output_message = [](j_common_ptr) {};
+    jpeg_create_decompress(&mInfo);
+
+    // Older libjpeg versions take a non-const buffer that they never write
+    jpeg_mem_src(&mInfo, const_cast<unsigned char*>(data), static_cast<unsigned long>(size));
+}
+
+JpegDecoder::~JpegDecoder() {
+    jpeg_destroy_decompress(&mInfo);
+    if (mFile != nullptr) {
+        std::fclose(mFile);
+    }
+}
+
+void JpegDecoder::exit(const j_common_ptr info) {
+    // mError.manager is the first member of mError, so err points at the Error
+    std::longjmp(reinterpret_cast<Error*>(info->err)->jump, 1);
+}
+
+bool JpegDecoder::readHeader() {
+    if (mInfo.src == nullptr) return false;
+
+    if (setjmp(mError.jump)) return false;
+
+    if (jpeg_read_header(&mInfo, TRUE) != JPEG_HEADER_OK) return false;
+
+    return mInfo.jpeg_color_space != JCS_CMYK && mInfo.jpeg_color_space != JCS_YCCK;
+}
+
+void JpegDecoder::scale(const int minWidth, const int minHeight) {
+    if (setjmp(mError.jump)) {
+        throw std::runtime_error("Failed to decode image");
+    }
+
+    mInfo.scale_num = 1;
+    for (const unsigned denominator : {8u, 4u, 2u, 1u}) {
+        mInfo.scale_denom = denominator;
+        jpeg_calc_output_dimensions(&mInfo);
+        if (width() >= minWidth && height() >= minHeight) return;
+    }
+}
+
+void JpegDecoder::decode(uint8_t* rgba) {
+    if (setjmp(mError.jump)) {
+        throw std::runtime_error("Failed to decode image");
+    }
+
+#ifdef JCS_ALPHA_EXTENSIONS
+    // libjpeg-turbo writes RGBA directly, grayscale included
+    mInfo.out_color_space = JCS_EXT_RGBA;
+#else
+    mInfo.out_color_space = JCS_RGB;
+#endif
+    jpeg_start_decompress(&mInfo);
+
+    const size_t stride = static_cast<size_t>(mInfo.output_width) * 4;
+    while (mInfo.output_scanline < mInfo.output_height) {
+        uint8_t* row = rgba + stride * mInfo.output_scanline;
+#ifdef JCS_ALPHA_EXTENSIONS
+        JSAMPROW rows[] = {row};
+        jpeg_read_scanlines(&mInfo, rows, 1);
+#else
+        // RGB into the last three quarters of the row, then spread out front to back,
+        // which never overtakes the pixels still to be read
+        const uint8_t* rgb = row + mInfo.output_width;
+        JSAMPROW rows[] = {const_cast<uint8_t*>(rgb)};
+        jpeg_read_scanlines(&mInfo, rows, 1);
+        for (size_t i = 0; i < mInfo.output_width; ++i) {
+            const uint8_t r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+            row[i * 4] = r;
+            row[i * 4 + 1] = g;
+            row[i * 4 + 2] = b;
+            row[i * 4 + 3] = 255;
+        }
+#endif
+    }
+
+    jpeg_finish_decompress(&mInfo);
+}
@@ -0,0 +1,52 @@
+#ifndef JPEGDECODER_H
+#define JPEGDECODER_H
+
+#include <csetjmp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <jpeglib.h>
+
+// JPEG decoding through libjpeg, which can scale by 1/2, 1/4 or 1/8 while it
+// decodes: the inverse DCT then only computes the low frequencies of each block,
+// so a reduced image costs a fraction of a full decode plus a resize.
+class JpegDecoder {
+public:
+    explicit JpegDecoder(const char* name);
+
+    JpegDecoder(const uint8_t* data, size_t size);
+
+    ~JpegDecoder();
+
+    JpegDecoder(const JpegDecoder&) = delete;
+
+    JpegDecoder& operator=(const JpegDecoder&) = delete;
+
+    // False for anything but a colour or grayscale JPEG, which is then left to stb
+    bool readHeader();
+
+    // Picks the largest reduction that keeps the output at least minWidth x minHeight;
+    // width() and height() then give the output size
+    void scale(int minWidth, int minHeight);
+
+    [[nodiscard]] int width() const { return static_cast<int>(mInfo.output_width); }
+
+    [[nodiscard]] int height() const { return static_cast<int>(mInfo.output_height); }
+
+    // Writes width() x height() RGBA pixels
+    void decode(uint8_t* rgba);
+
+private:
+    struct Error {
+        jpeg_error_mgr manager;
+        std::jmp_buf jump;
+    };
+
+    [[noreturn]] static void exit(j_common_ptr info);
+
+    jpeg_decompress_struct mInfo{};
+    Error mError{};
+    std::FILE* mFile{nullptr};
+};
+
+#endif //JPEGDECODER_H
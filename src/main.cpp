@@ -1,7 +1,19 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
-#include "clPipeline.h"
+#include <filesystem>
+#include <format>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "decoder.h"
+#include "engine.h"
 #include "image.h"
+#include "poolAllocator.h"
+#include "writer.h"
+#ifdef PIXCL_SERVER
+#include "server.h"
+#endif
 
 #define VERSION_MAJOR 0
 #define VERSION_MINOR 1
@@ -18,23 +30,139 @@
 typedef struct Args {
     const char* effect;
     const char* format;
-    const char* image;
+    std::vector<const char*> images;
     const char* outfile;
+    const char* socket;
     int quality;
+    int decodeThreads;
+    size_t decodeMemory;
+    int pngLevel;
+    int encodeThreads;
+    int writeThreads;
+    SyncPolicy sync;
+    bool hugePages;
+    bool specialise;
+    DeviceType device;
+    Precision precision;
+    const char* kernel;
+    const char* fftCrossover;
+    BlurMode blurMode;
+    float sigma;
+    int boxRadius;
+    int thresholdRadius;
+    float thresholdBias;
+    int bilateralRadius;
+    float bilateralRange;
+    int medianRadius;
+    float cannyLow;
+    float cannyHigh;
+    int claheTiles;
+    float claheClip;
+    bool stats;
+    int resizeWidth;
+    int resizeHeight;
+    ResizeFilter filter;
+    int pyramidLevels;
 } Args;
 
+static PixelBuffer pixels(const Image& image) {
+    return {image.raw(), image.width(), image.height(), 0, PixelFormat::RGBA8};
+}
+
+static void printStatistics(const std::string& path, const ImageStats& stats) {
+    static constexpr char channels[] = "RGBA";
+    std::cout << path << ":";
+    for (int c = 0; c < 4; ++c) {
+        const ChannelStats& channel = stats[c];
+        std::cout << std::format(" {} mean={:.3f} stddev={:.3f} min={} max={} sum={}", channels[c], channel.mean,
+                                 channel.stddev, static_cast<int>(channel.min), static_cast<int>(channel.max),
+                                 channel.sum);
+    }
+    std::cout << std::endl;
+}
+
+// Runs chain on in as a pyramid of args.pyramidLevels levels and hands them to
+// writer; level i of dir/name.ext goes to dir/name_i.ext
+static void writePyramid(Engine& engine, const std::vector<Effect>& chain, const Image& in, const Args& args,
+                         const ImageFormat format, const std::filesystem::path& path, AsyncWriter& writer) {
+    std::vector<Image> levels(args.pyramidLevels);
+    std::vector<PixelBuffer> buffers;
+    auto [width, height] = engine.outputSize(chain, in.width(), in.height());
+    for (Image& level : levels) {
+        level.create(width, height, 4, format);
+        buffers.push_back(pixels(level));
+        std::tie(width, height) = Engine::nextLevel(width, height);
+    }
+
+    engine.pyramid(chain, pixels(in), buffers);
+
+    for (int i = 0; i < args.pyramidLevels; ++i) {
+        const auto name = path.parent_path() /
+                          (path.stem().string() + "_" + std::to_string(i) + path.extension().string());
+        if (args.stats && i == 0) printStatistics(name.string(), engine.statistics());
+        writer.submit(std::move(levels[i]), name.string());
+    }
+}
+
+// A JPEG quality rather than an input: a whole number from 0 to 100 that names no file
+static bool isQuality(const char* arg) {
+    char* end;
+    const long quality = strtol(arg, &end, 10);
+    return end != arg && *end == '\0' && quality >= 0 && quality <= 100 && !std::filesystem::exists(arg);
+}
+
 static Args parseArgs(int argc, char** argv) {
     static const char* usage = "OVERVIEW: An OpenCL-based image processing tool\n\n"
-            "USAGE: pixcl [options] <image file>\n\n"
+            "USAGE: pixcl [options] <image file>...\n\n"
             "OPTIONS:\n"
-            "  -e, --effect          Effect to be applied[gb/gs/sep]\n"
+            "  -e, --effect          Effect to be applied[gb/gs/sep/conv/box/thr/bl/med/sobel/canny/eq/clahe/resize], comma separated for a chain\n"
             "  -f, --format          File format[jpg <quality 0-100>?/png/bmp/tga/raw]\n"
-            "  -o, --outfile         Output file name\n"
+            "  -o, --outfile         Output file name, or output directory for several images\n"
+            "      --decode-threads  Threads decoding upcoming images in batch mode\n"
+            "      --decode-memory   Memory limit in MB for decoded images waiting in batch mode\n"
+            "      --png-level       PNG compression level[0-9], lower is faster\n"
+            "      --encode-threads  Threads deflating each PNG\n"
+            "      --write-threads   Threads encoding and writing outputs in the background\n"
+            "      --fsync           When outputs are synced to disk[none/file/batch]\n"
+            "      --huge-pages      Back large pixel buffers with huge pages where supported\n"
+            "      --specialise      Compile kernels for the image size, for inputs of one size\n"
+            "      --device          OpenCL device type to run on[gpu/cpu]\n"
+            "      --precision       Blur and sepia arithmetic[fp32/fp16/fixed]\n"
+            "      --kernel          Matrix for conv[sharpen/emboss/edge/<file>/<rows a,b;c,d>]\n"
+            "      --fft-crossover   Taps above which conv runs through FFTs, or auto to measure it once per device\n"
+            "      --blur-mode       How gb is computed[exact/approx]\n"
+            "      --sigma           Standard deviation of gb in approx mode\n"
+            "      --box-radius      Radius of box, whose window is 2 * radius + 1 wide\n"
+            "      --thr-radius      Radius of the window thr compares each pixel with\n"
+            "      --thr-bias        Fraction below the window mean at which thr turns white\n"
+            "      --bl-radius       Window radius of bl\n"
+            "      --bl-range        Colour distance over which bl stops averaging\n"
+            "      --med-radius      Window radius of med[0-127]\n"
+            "      --canny-low       Gradient above which canny keeps edges connected to strong ones\n"
+            "      --canny-high      Gradient above which canny keeps every edge\n"
+            "      --clahe-tiles     Tiles per side that clahe equalises separately\n"
+            "      --clahe-clip      Histogram clip limit of clahe, relative to the average bin\n"
+            "      --stats           Print per-channel mean, stddev, min, max and sum of each output\n"
+            "      --size            Output size of resize as WxH, 0 for one side keeps the aspect ratio\n"
+            "      --filter          Resampling filter of resize[bilinear/bicubic/lanczos]\n"
+            "      --pyramid         Levels to write, each half the size of the one before, as <name>_<level>\n"
+#ifdef PIXCL_SERVER
+            "      --serve           Serve requests on the given Unix socket path using the options above\n"
+#endif
             "  -h, --help            Display available options\n"
             "  -v, --version         Display the version of this program\n";
 
-    Args args = {nullptr, nullptr, nullptr, nullptr};
-    if (argc < 8) {
+    const auto cores = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    Args args = {nullptr, nullptr, {}, nullptr, nullptr, 100, cores, 512, 8, cores, 2, SyncPolicy::NONE, false, false,
+                 DeviceType::GPU, Precision::FP32, nullptr, "auto", BlurMode::EXACT, 1.0f, 2, 7, 0.15f, 3, 30.0f, 1, 50.0f, 100.0f, 8, 2.0f, false,
+                 0, 0, ResizeFilter::LANCZOS3, 0};
+#ifdef PIXCL_SERVER
+    // Server mode takes the engine options without an effect, format or images
+    const bool serve = std::any_of(argv + 1, argv + argc, [](const char* arg) { return !std::strcmp(arg, "--serve"); });
+#else
+    constexpr bool serve = false;
+#endif
+    if (argc < 8 && !serve) {
         if (argc == 2 && (!std::strcmp(argv[1], "-h") || !std::strcmp(argv[1], "--help"))) {
             std::cout << usage;
             return args;
@@ -62,63 +190,189 @@ static Args parseArgs(int argc, char** argv) {
                 throw std::runtime_error("Unknown Format: " + std::string(args.format));
             }
 
-            int tmp = i;
-            args.quality = static_cast<int>(strtol(argv[++tmp], nullptr, 10));
+            // Optional quality, consumed only when it is a number
+            if (i + 1 < argc && isQuality(argv[i + 1])) {
+                args.quality = static_cast<int>(strtol(argv[++i], nullptr, 10));
+            }
         } else if (!std::strcmp(argv[i], "-o") || !std::strcmp(argv[i], "--outfile")) {
             args.outfile = argv[++i];
+        } else if (!std::strcmp(argv[i], "--decode-threads")) {
+            args.decodeThreads = static_cast<int>(strtol(argv[++i], nullptr, 10));
+        } else if (!std::strcmp(argv[i], "--decode-memory")) {
+            args.decodeMemory = strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--png-level")) {
+            args.pngLevel = static_cast<int>(strtol(argv[++i], nullptr, 10));
+
+            if (args.pngLevel < 0 || args.pngLevel > 9) {
+                throw std::runtime_error("Invalid PNG level: " + std::string(argv[i]));
+            }
+        } else if (!std::strcmp(argv[i], "--encode-threads")) {
+            args.encodeThreads = static_cast<int>(strtol(argv[++i], nullptr, 10));
+        } else if (!std::strcmp(argv[i], "--write-threads")) {
+            args.writeThreads = static_cast<int>(strtol(argv[++i], nullptr, 10));
+        } else if (!std::strcmp(argv[i], "--fsync")) {
+            args.sync = AsyncWriter::getPolicy(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--huge-pages")) {
+            args.hugePages = true;
+        } else if (!std::strcmp(argv[i], "--specialise")) {
+            args.specialise = true;
+        } else if (!std::strcmp(argv[i], "--device")) {
+            args.device = CLPipeline::getDeviceType(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--precision")) {
+            args.precision = Engine::getPrecision(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--kernel")) {
+            args.kernel = argv[++i];
+        } else if (!std::strcmp(argv[i], "--fft-crossover")) {
+            args.fftCrossover = argv[++i];
+        } else if (!std::strcmp(argv[i], "--blur-mode")) {
+            args.blurMode = Engine::getBlurMode(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--sigma")) {
+            args.sigma = strtof(argv[++i], nullptr);
+        } else if (!std::strcmp(argv[i], "--box-radius")) {
+            args.boxRadius = static_cast<int>(strtol(argv[++i], nullptr, 10));
+        } else if (!std::strcmp(argv[i], "--thr-radius")) {
+            args.thresholdRadius = static_cast<int>(strtol(argv[++i], nullptr, 10));
+        } else if (!std::strcmp(argv[i], "--thr-bias")) {
+            args.thresholdBias = strtof(argv[++i], nullptr);
+        } else if (!std::strcmp(argv[i], "--bl-radius")) {
+            args.bilateralRadius = static_cast<int>(strtol(argv[++i], nullptr, 10));
+        } else if (!std::strcmp(argv[i], "--bl-range")) {
+            args.bilateralRange = strtof(argv[++i], nullptr);
+        } else if (!std::strcmp(argv[i], "--med-radius")) {
+            args.medianRadius = static_cast<int>(strtol(argv[++i], nullptr, 10));
+        } else if (!std::strcmp(argv[i], "--canny-low")) {
+            args.cannyLow = strtof(argv[++i], nullptr);
+        } else if (!std::strcmp(argv[i], "--canny-high")) {
+            args.cannyHigh = strtof(argv[++i], nullptr);
+        } else if (!std::strcmp(argv[i], "--clahe-tiles")) {
+            args.claheTiles = static_cast<int>(strtol(argv[++i], nullptr, 10));
+        } else if (!std::strcmp(argv[i], "--clahe-clip")) {
+            args.claheClip = strtof(argv[++i], nullptr);
+        } else if (!std::strcmp(argv[i], "--stats")) {
+            args.stats = true;
+        } else if (!std::strcmp(argv[i], "--size")) {
+            char* end;
+            args.resizeWidth = static_cast<int>(strtol(argv[++i], &end, 10));
+            args.resizeHeight = *end == 'x' ? static_cast<int>(strtol(end + 1, nullptr, 10)) : 0;
+        } else if (!std::strcmp(argv[i], "--filter")) {
+            args.filter = Resizer::getFilter(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--pyramid")) {
+            args.pyramidLevels = static_cast<int>(strtol(argv[++i], nullptr, 10));
+#ifdef PIXCL_SERVER
+        } else if (!std::strcmp(argv[i], "--serve")) {
+            args.socket = argv[++i];
+#endif
         } else {
-            args.image = argv[i];
+            args.images.push_back(argv[i]);
         }
     }
 
     return args;
 }
 
+// Applies every effect setting in args; a measured FFT crossover is only worth the
+// calibration when conv will run
+static void configure(Engine& engine, const Args& args, const bool convolves) {
+    engine.setSpecialised(args.specialise);
+    engine.setPrecision(args.precision);
+    if (std::strcmp(args.fftCrossover, "auto") != 0) {
+        engine.setFftCrossover(strtoull(args.fftCrossover, nullptr, 10));
+    } else if (convolves) {
+        engine.calibrateFftCrossover();
+    }
+    engine.setBlurMode(args.blurMode, args.sigma);
+    engine.setBoxRadius(args.boxRadius);
+    engine.setThreshold(args.thresholdRadius, args.thresholdBias);
+    engine.setBilateral(args.bilateralRadius, args.bilateralRange);
+    engine.setMedianRadius(args.medianRadius);
+    engine.setCanny(args.cannyLow, args.cannyHigh);
+    engine.setClahe(args.claheTiles, args.claheClip);
+    engine.setStatistics(args.stats);
+    if (args.resizeWidth || args.resizeHeight) {
+        engine.setResize(args.resizeWidth, args.resizeHeight, args.filter);
+    }
+    if (args.kernel != nullptr) {
+        engine.setConvolution(Convolution::parse(args.kernel));
+    }
+}
+
 int main(int argc, char** argv) {
     // Parse Arguments
     const Args args = parseArgs(argc, argv);
-    if (args.image == nullptr) return 0;
+#ifdef PIXCL_SERVER
+    if (args.socket != nullptr) {
+        PoolAllocator::instance().setHugePages(args.hugePages);
 
-    Image in{}, out{};
-    in.load(args.image);
+        // Requests can only run conv with the matrix given here
+        Engine engine(args.device);
+        configure(engine, args, args.kernel != nullptr);
+
+        Server server(args.socket, engine, {args.quality, args.pngLevel, args.encodeThreads});
+        server.run();
+    }
+#endif
+    if (args.images.empty()) return 0;
+
+    PoolAllocator::instance().setHugePages(args.hugePages);
 
     const ImageFormat format = Image::getFormat(args.format);
-    out.create(in.width(), in.height(), 4, format);
-
-    CLPipeline pipeline;
-    cl_mem inputBuffer = pipeline.createBuffer(BufferType::INPUT, in.width(), in.height(),
-                                               CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, in.raw());
-    cl_mem outputBuffer = pipeline.createBuffer(BufferType::OUTPUT, out.width(), out.height(), CL_MEM_WRITE_ONLY);
-
-    if (!std::strcmp(args.effect, "gb")) {
-        cl_mem kernelBuffer = pipeline.createBuffer(BufferType::KERNEL);
-        // Create Program
-        pipeline.createProgram("gaussian_blur");
-        // Create Kernel
-        pipeline.createKernel("gaussian_blur");
-        pipeline.setKernelArgs(inputBuffer, outputBuffer, in.width(), in.height(), kernelBuffer);
-    } else if (!std::strcmp(args.effect, "gs")) {
-        // Create Program
-        pipeline.createProgram("grayscale");
-        // Create Kernel
-        pipeline.createKernel("grayscale");
-        pipeline.setKernelArgs(inputBuffer, outputBuffer, in.width(), in.height());
-    } else if (!std::strcmp(args.effect, "sep")) {
-        // Create Program
-        pipeline.createProgram("sepia_filter");
-        // Create Kernel
-        pipeline.createKernel("sepia_filter");
-        pipeline.setKernelArgs(inputBuffer, outputBuffer, in.width(), in.height());
+    const std::vector<Effect> chain = Engine::getEffects(args.effect);
+    Engine engine(args.device);
+    configure(engine, args, std::ranges::find(chain, Effect::CONVOLVE) != chain.end());
+    // A chain starting with a resize only needs the input at its output size, which
+    // JPEGs can decode to directly
+    DecodeOptions decodeOptions;
+    if (chain.front() == Effect::RESIZE) {
+        decodeOptions = {args.resizeWidth, args.resizeHeight};
     }
+    // Finished images are handed over so the device can start on the next one while they are encoded
+    AsyncWriter writer(args.writeThreads, args.sync, {args.quality, args.pngLevel, args.encodeThreads});
+
+    if (args.images.size() == 1) {
+        Image in{}, out{};
+        in.load(args.images.front(), engine.hostAllocator(), decodeOptions);
+        if (args.pyramidLevels > 0) {
+            writePyramid(engine, chain, in, args, format, args.outfile, writer);
+        } else {
+            const auto [width, height] = engine.outputSize(chain, in.width(), in.height());
+            out.create(width, height, 4, format);
+
+            engine.process(chain, pixels(in), pixels(out));
+            if (args.stats) printStatistics(args.outfile, engine.statistics());
+
+            writer.submit(std::move(out), args.outfile);
+        }
+    } else {
+        // Batch mode: upcoming images are decoded in the background while the current one is processed
+        const std::filesystem::path outdir(args.outfile);
+        std::filesystem::create_directories(outdir);
+
+        Decoder decoder({args.images.begin(), args.images.end()}, args.decodeThreads, args.decodeMemory << 20,
+                        engine.hostAllocator(), decodeOptions);
+        for (size_t i = 0; const auto in = decoder.next(); ++i) {
+            const auto name = std::filesystem::path(decoder.file(i)).stem().string() + "." + args.format;
+            if (args.pyramidLevels > 0) {
+                writePyramid(engine, chain, *in, args, format, outdir / name, writer);
+                continue;
+            }
 
-    pipeline.execute(in.width(), in.height());
+            Image out{};
+            const auto [width, height] = engine.outputSize(chain, in->width(), in->height());
+            out.create(width, height, 4, format);
 
-    pipeline.readBuffer(outputBuffer, out.raw(), out.width(), out.height());
+            engine.process(chain, pixels(*in), pixels(out));
 
-    out.write(args.outfile);
+            if (args.stats) printStatistics((outdir / name).string(), engine.statistics());
+            writer.submit(std::move(out), (outdir / name).string());
+        }
+    }
 
-    if constexpr (PROFILE)
-        pipeline.printProfilingInfo();
+    writer.flush();
+
+    if constexpr (PROFILE) {
+        engine.printProfilingInfo();
+        PoolAllocator::instance().printStats();
+    }
 
     return 0;
 }
@@ -0,0 +1,66 @@
+#include "pinnedAllocator.h"
+#include <algorithm>
+
+PinnedAllocator::PinnedAllocator(CLPipeline& pipeline, const size_t maxCached)
+    : mPipeline(pipeline), mMaxCached(maxCached) {}
+
+uint8_t* PinnedAllocator::allocate(const size_t size) {
+    Block block{};
+    {
+        std::lock_guard lock(mMutex);
+        // Reuse a free buffer unless it would waste more than half of itself
+        const auto it = std::ranges::find_if(mFree, [size](const Block& free) {
+            return free.capacity >= size && free.capacity / 2 <= size;
+        });
+        if (it != mFree.end()) {
+            block = std::move(*it);
+            mFree.erase(it);
+        }
+    }
+
+    if (!block.buffer) {
+        block.buffer = mPipeline.createBuffer(size, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR);
+        block.capacity = size;
+    }
+
+    // The decoder overwrites everything, so the previous contents need not be transferred
+    auto* ptr = static_cast<uint8_t*>(mPipeline.mapBuffer(block.buffer.get(), size, CL_MAP_WRITE_INVALIDATE_REGION));
+    block.mapped = true;
+
+    std::lock_guard lock(mMutex);
+    mBlocks.emplace(ptr, std::move(block));
+    return ptr;
+}
+
+void PinnedAllocator::deallocate(uint8_t* ptr, size_t) {
+    std::unique_lock lock(mMutex);
+    auto node = mBlocks.extract(ptr);
+    lock.unlock();
+
+    Block& block = node.mapped();
+    if (block.mapped) {
+        mPipeline.unmapBuffer(block.buffer.get(), ptr);
+        block.mapped = false;
+    }
+
+    lock.lock();
+    if (mFree.size() < mMaxCached) {
+        mFree.push_back(std::move(block));
+    }
+}
+
+cl_mem PinnedAllocator::acquire(const uint8_t* ptr) {
+    std::unique_lock lock(mMutex);
+    const auto it = mBlocks.find(ptr);
+    if (it == mBlocks.end()) return nullptr;
+
+    Block& block = it->second;
+    if (block.mapped) {
+        // The image is owned by the calling thread, so the block cannot go away meanwhile
+        lock.unlock();
+        mPipeline.unmapBuffer(block.buffer.get(), const_cast<uint8_t*>(ptr));
+        block.mapped = false;
+    }
+
+    return block.buffer.get();
+}
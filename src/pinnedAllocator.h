@@ -0,0 +1,48 @@
+#ifndef PINNEDALLOCATOR_H
+#define PINNEDALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "clPipeline.h"
+#include "image.h"
+
+// Pixel memory backed by CL_MEM_ALLOC_HOST_PTR buffers, mapped for the host while an
+// image is decoded into it. On integrated GPUs the device reads the decoded pixels in
+// place; elsewhere the driver transfers from pinned memory, skipping a staging copy.
+// acquire() hands the buffer over to the device: the image's pixels must not be read
+// on the host afterwards. Every image must be released before the allocator, and so
+// before its pipeline. Thread-safe.
+class PinnedAllocator final : public ImageAllocator {
+public:
+    explicit PinnedAllocator(CLPipeline& pipeline, size_t maxCached = 8);
+
+    PinnedAllocator(const PinnedAllocator&) = delete;
+
+    PinnedAllocator& operator=(const PinnedAllocator&) = delete;
+
+    uint8_t* allocate(size_t size) override;
+
+    void deallocate(uint8_t* ptr, size_t size) override;
+
+    // Unmaps the buffer behind ptr and returns it, or nullptr if ptr did not come from here
+    cl_mem acquire(const uint8_t* ptr);
+
+private:
+    struct Block {
+        CLMem buffer;
+        size_t capacity;
+        bool mapped;
+    };
+
+    CLPipeline& mPipeline;
+    size_t mMaxCached;
+
+    std::mutex mMutex;
+    std::unordered_map<const uint8_t*, Block> mBlocks;
+    std::vector<Block> mFree;
+};
+
+#endif //PINNEDALLOCATOR_H
@@ -0,0 +1,225 @@
+#include "pngEncoder.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <zlib.h>
+
+namespace {
+
+struct Band {
+    int first;
+    int last;
+    std::vector<uint8_t> deflated;
+    uLong adler;
+    std::exception_ptr error;
+};
+
+// Ends the stream however the band's compression leaves; deflateEnd ignores a
+// stream whose initialisation failed
+struct Deflater {
+    z_stream stream{};
+
+    ~Deflater() { deflateEnd(&stream); }
+};
+
+void putBE32(std::vector<uint8_t>& out, const uint32_t v) {
+    out.push_back(static_cast<uint8_t>(v >> 24));
+    out.push_back(static_cast<uint8_t>(v >> 16));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+uint8_t paeth(const int a, const int b, const int c) {
+    const int p = a + b - c;
+    const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+    if (pb <= pc) return static_cast<uint8_t>(b);
+    return static_cast<uint8_t>(c);
+}
+}
+
+std::vector<uint8_t> PngEncoder::encode(const uint8_t* pixels, const int width, const int height, const int channels,
+                                        const int level, const int threads) {
+    static constexpr uint8_t colorTypes[] = {0, 0, 4, 2, 6};
+    if (channels < 1 || channels > 4) {
+        throw std::runtime_error("Unsupported channel count for PNG");
+    }
+
+    const size_t rowSize = static_cast<size_t>(width) * channels + 1;
+    const int bandCount = std::clamp(height / MIN_BAND_ROWS, 1, std::max(threads, 1));
+
+    std::vector<Band> bands(bandCount);
+    for (int i = 0; i < bandCount; ++i) {
+        bands[i].first = static_cast<int>(static_cast<int64_t>(height) * i / bandCount);
+        bands[i].last = static_cast<int>(static_cast<int64_t>(height) * (i + 1) / bandCount);
+    }
+
+    // Filtered rows of the whole image; each band fills and compresses its own slice,
+    // using the tail of the previous slice as its dictionary to keep the ratio close
+    // to a single-threaded encode
+    std::vector<uint8_t> filtered(rowSize * height);
+
+    auto compress = [&](Band& band) {
+        uint8_t* slice = filtered.data() + rowSize * band.first;
+        const size_t sliceSize = rowSize * (band.last - band.first);
+        filterRows(pixels, width, channels, band.first, band.last, level, slice);
+
+        Deflater deflater;
+        z_stream& stream = deflater.stream;
+        if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("Failed to initialise deflate");
+        }
+
+        if (band.first > 0) {
+            // The previous slice may still be in progress, so refilter its tail instead
+            const int prevFirst = std::max(0, band.first - static_cast<int>(32768 / rowSize) - 1);
+            std::vector<uint8_t> window(rowSize * (band.first - prevFirst));
+            filterRows(pixels, width, channels, prevFirst, band.first, level, window.data());
+            const size_t dictSize = std::min<size_t>(window.size(), 32768);
+            deflateSetDictionary(&stream, window.data() + window.size() - dictSize, static_cast<uInt>(dictSize));
+        }
+
+        band.deflated.resize(deflateBound(&stream, sliceSize) + 16);
+        stream.next_in = slice;
+        stream.avail_in = static_cast<uInt>(sliceSize);
+        stream.next_out = band.deflated.data();
+        stream.avail_out = static_cast<uInt>(band.deflated.size());
+
+        const bool isLast = band.last == height;
+        const int status = deflate(&stream, isLast ? Z_FINISH : Z_SYNC_FLUSH);
+        band.deflated.resize(band.deflated.size() - stream.avail_out);
+
+        if (status != (isLast ? Z_STREAM_END : Z_OK)) {
+            throw std::runtime_error("Failed to deflate PNG data");
+        }
+
+        band.adler = adler32(adler32(0L, Z_NULL, 0), slice, static_cast<uInt>(sliceSize));
+    };
+
+    // A throw must not escape a worker, nor leave the calling thread with workers unjoined,
+    // so errors are kept per band and rethrown once every band is done
+    auto run = [&](Band& band) {
+        try {
+            compress(band);
+        } catch (...) {
+            band.error = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(bandCount - 1);
+    int spawned = 1;
+    try {
+        for (; spawned < bandCount; ++spawned) {
+            workers.emplace_back(run, std::ref(bands[spawned]));
+        }
+    } catch (const std::system_error&) {
+        // Out of threads; the bands without one run here
+    }
+    run(bands[0]);
+    for (int i = spawned; i < bandCount; ++i) {
+        run(bands[i]);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (const Band& band : bands) {
+        if (band.error) {
+            std::rethrow_exception(band.error);
+        }
+    }
+
+    // zlib stream: header, concatenated bands, combined Adler-32
+    std::vector<uint8_t> idat;
+    const int flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    const uint8_t cmf = 0x78;
+    auto flg = static_cast<uint8_t>(flevel << 6);
+    flg += 31 - (cmf * 256 + flg) % 31;
+    idat.push_back(cmf);
+    idat.push_back(flg);
+
+    uLong adler = bands[0].adler;
+    for (int i = 0; i < bandCount; ++i) {
+        idat.insert(idat.end(), bands[i].deflated.begin(), bands[i].deflated.end());
+        if (i > 0) {
+            const auto len = static_cast<z_off_t>(rowSize * (bands[i].last - bands[i].first));
+            adler = adler32_combine(adler, bands[i].adler, len);
+        }
+    }
+    putBE32(idat, static_cast<uint32_t>(adler));
+
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::vector<uint8_t> header;
+    putBE32(header, width);
+    putBE32(header, height);
+    header.insert(header.end(), {8, colorTypes[channels], 0, 0, 0});
+
+    appendChunk(png, "IHDR", header.data(), header.size());
+    appendChunk(png, "IDAT", idat.data(), idat.size());
+    appendChunk(png, "IEND", nullptr, 0);
+
+    return png;
+}
+
+void PngEncoder::filterRows(const uint8_t* pixels, const int width, const int channels, const int first,
+                            const int last, const int level, uint8_t* out) {
+    const size_t stride = static_cast<size_t>(width) * channels;
+    std::vector<uint8_t> candidate(stride);
+
+    for (int y = first; y < last; ++y, out += stride + 1) {
+        const uint8_t* row = pixels + stride * y;
+        const uint8_t* prev = y > 0 ? row - stride : nullptr;
+
+        // Stored output gains nothing from filtering
+        if (level == 0) {
+            out[0] = 0;
+            std::memcpy(out + 1, row, stride);
+            continue;
+        }
+
+        // Same heuristic as stb: keep the filter with the smallest sum of absolute values
+        uint64_t bestScore = UINT64_MAX;
+        for (int type = 0; type < 5; ++type) {
+            uint64_t score = 0;
+            for (size_t i = 0; i < stride; ++i) {
+                const int a = i >= static_cast<size_t>(channels) ? row[i - channels] : 0;
+                const int b = prev ? prev[i] : 0;
+                const int c = prev && i >= static_cast<size_t>(channels) ? prev[i - channels] : 0;
+
+                uint8_t v = row[i];
+                switch (type) {
+                    case 1: v -= a; break;
+                    case 2: v -= b; break;
+                    case 3: v -= (a + b) >> 1; break;
+                    case 4: v -= paeth(a, b, c); break;
+                    default: break;
+                }
+                candidate[i] = v;
+                score += std::abs(static_cast<int8_t>(v));
+            }
+
+            if (score < bestScore) {
+                bestScore = score;
+                out[0] = static_cast<uint8_t>(type);
+                std::memcpy(out + 1, candidate.data(), stride);
+            }
+        }
+    }
+}
+
+void PngEncoder::appendChunk(std::vector<uint8_t>& png, const char* type, const uint8_t* data, const size_t size) {
+    putBE32(png, static_cast<uint32_t>(size));
+    const size_t start = png.size();
+    png.insert(png.end(), type, type + 4);
+    if (size > 0) {
+        png.insert(png.end(), data, data + size);
+    }
+
+    const uLong crc = crc32(0L, png.data() + start, static_cast<uInt>(png.size() - start));
+    putBE32(png, static_cast<uint32_t>(crc));
+}
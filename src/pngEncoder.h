@@ -0,0 +1,27 @@
+#ifndef PNGENCODER_H
+#define PNGENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// PNG encoder that filters and deflates horizontal bands of rows on separate
+// threads. Every band but the last ends with a sync flush, which byte-aligns it
+// without terminating the stream, so the bands concatenate into a single valid
+// zlib stream; the Adler-32 checksums of the bands are combined for the trailer.
+class PngEncoder {
+public:
+    static std::vector<uint8_t> encode(const uint8_t* pixels, int width, int height, int channels, int level,
+                                       int threads);
+
+private:
+    static void filterRows(const uint8_t* pixels, int width, int channels, int first, int last, int level,
+                           uint8_t* out);
+
+    static void appendChunk(std::vector<uint8_t>& png, const char* type, const uint8_t* data, size_t size);
+
+    // Bands smaller than this compress poorly and are not worth a thread
+    static constexpr int MIN_BAND_ROWS = 64;
+};
+
+#endif //PNGENCODER_H
@@ -0,0 +1,130 @@
+#include "poolAllocator.h"
+#include <algorithm>
+#include <bit>
+#include <iostream>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+PoolAllocator::PoolAllocator(const size_t maxCached) : mMaxCached(maxCached) {
+#ifdef _WIN32
+    mPageSize = 4096;
+#else
+    mPageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+PoolAllocator::~PoolAllocator() {
+    for (auto& [size, blocks] : mFree) {
+        for (uint8_t* block : blocks) {
+            unmap(block, size);
+        }
+    }
+}
+
+PoolAllocator& PoolAllocator::instance() {
+    static PoolAllocator pool;
+    return pool;
+}
+
+uint8_t* PoolAllocator::allocate(const size_t size) {
+    const size_t bytes = classSize(size);
+    {
+        std::lock_guard lock(mMutex);
+        if (auto it = mFree.find(bytes); it != mFree.end() && !it->second.empty()) {
+            uint8_t* block = it->second.back();
+            it->second.pop_back();
+            mStats.cached -= bytes;
+            mStats.inUse += bytes;
+            ++mStats.hits;
+            return block;
+        }
+    }
+
+    uint8_t* block = map(bytes);
+
+    std::lock_guard lock(mMutex);
+    mStats.reserved += bytes;
+    mStats.peakReserved = std::max(mStats.peakReserved, mStats.reserved);
+    mStats.inUse += bytes;
+    ++mStats.misses;
+    return block;
+}
+
+void PoolAllocator::deallocate(uint8_t* ptr, const size_t size) {
+    if (ptr == nullptr) return;
+
+    const size_t bytes = classSize(size);
+    {
+        std::lock_guard lock(mMutex);
+        mStats.inUse -= bytes;
+        if (mStats.cached + bytes <= mMaxCached) {
+            mFree[bytes].push_back(ptr);
+            mStats.cached += bytes;
+            return;
+        }
+        mStats.reserved -= bytes;
+    }
+
+    unmap(ptr, bytes);
+}
+
+PoolStats PoolAllocator::stats() const {
+    std::lock_guard lock(mMutex);
+    return mStats;
+}
+
+void PoolAllocator::printStats() const {
+    const PoolStats s = stats();
+    constexpr double MB = 1024.0 * 1024.0;
+    std::cout << "Pool Reserved: " << static_cast<double>(s.reserved) / MB << " MB (peak "
+            << static_cast<double>(s.peakReserved) / MB << " MB), in use " << static_cast<double>(s.inUse) / MB
+            << " MB, cached " << static_cast<double>(s.cached) / MB << " MB, " << s.hits << " hits / " << s.misses
+            << " misses" << std::endl;
+}
+
+size_t PoolAllocator::classSize(const size_t size) const {
+    size_t pages = std::max<size_t>((size + mPageSize - 1) / mPageSize, 1);
+    if (pages > 4) {
+        // Four classes per power of two
+        const size_t step = std::bit_floor(pages) / 4;
+        pages = (pages + step - 1) / step * step;
+    }
+
+    size_t bytes = pages * mPageSize;
+    if (mHugePages && bytes >= HUGE_PAGE_SIZE) {
+        bytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    }
+
+    return bytes;
+}
+
+uint8_t* PoolAllocator::map(const size_t size) const {
+#ifdef _WIN32
+    void* block = _aligned_malloc(size, mPageSize);
+    if (block == nullptr) throw std::bad_alloc();
+#else
+    void* block = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED) throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+    if (mHugePages && size >= HUGE_PAGE_SIZE) {
+        madvise(block, size, MADV_HUGEPAGE);
+    }
+#endif
+#endif
+
+    return static_cast<uint8_t*>(block);
+}
+
+void PoolAllocator::unmap(uint8_t* ptr, const size_t size) {
+#ifdef _WIN32
+    (void) size;
+    _aligned_free(ptr);
+#else
+    munmap(ptr, size);
+#endif
+}
@@ -0,0 +1,69 @@
+#ifndef POOLALLOCATOR_H
+#define POOLALLOCATOR_H
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "image.h"
+
+struct PoolStats {
+    size_t reserved;    // bytes currently mapped from the OS, the pool's share of RSS
+    size_t peakReserved;
+    size_t inUse;       // bytes handed out and not yet returned
+    size_t cached;      // bytes kept for reuse
+    size_t hits;        // allocations served from the cache
+    size_t misses;      // allocations that had to map new memory
+};
+
+// Page-aligned pixel memory, recycled through size classes. Sizes are rounded
+// up to classes at most 25% apart, so buffers of similar images are reused
+// instead of being mapped and faulted in again for every image of a batch.
+// Page alignment satisfies CL_DEVICE_MEM_BASE_ADDR_ALIGN, as required by
+// CL_MEM_USE_HOST_PTR, and aligned SIMD loads. Thread-safe.
+class PoolAllocator final : public ImageAllocator {
+public:
+    explicit PoolAllocator(size_t maxCached = 256u << 20);
+
+    ~PoolAllocator() override;
+
+    PoolAllocator(const PoolAllocator&) = delete;
+
+    PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+    uint8_t* allocate(size_t size) override;
+
+    void deallocate(uint8_t* ptr, size_t size) override;
+
+    // Back allocations of at least HUGE_PAGE_SIZE with transparent huge pages where
+    // supported. Changes size classes, so set it before the first allocation.
+    void setHugePages(bool enabled) { mHugePages = enabled; }
+
+    [[nodiscard]] PoolStats stats() const;
+
+    void printStats() const;
+
+    // Shared pool used by Image::create by default
+    static PoolAllocator& instance();
+
+    static constexpr size_t HUGE_PAGE_SIZE = 2u << 20;
+
+private:
+    [[nodiscard]] size_t classSize(size_t size) const;
+
+    uint8_t* map(size_t size) const;
+
+    static void unmap(uint8_t* ptr, size_t size);
+
+    size_t mPageSize;
+    size_t mMaxCached;
+    std::atomic<bool> mHugePages{false};
+
+    mutable std::mutex mMutex;
+    std::unordered_map<size_t, std::vector<uint8_t*>> mFree;
+    PoolStats mStats{};
+};
+
+#endif //POOLALLOCATOR_H
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+// Wire format shared by the server and pixcl-client. Every field is a frame:
+// a 32-bit big-endian length followed by that many bytes.
+//
+//   request  := chain format source-kind source outfile
+//   response := status payload
+//
+// chain is an effect chain ("gs,gb"), format is "<fmt> [quality]", source-kind is
+// "path" or "data". With an empty outfile the encoded image is returned inline in
+// payload; otherwise the server writes it and payload is empty. status is "ok" or
+// "error", in which case payload holds the message.
+namespace protocol {
+
+inline constexpr uint32_t MAX_FRAME_SIZE = 256u << 20;
+
+inline bool readAll(const int fd, void* data, size_t size) {
+    auto* p = static_cast<char*>(data);
+    while (size > 0) {
+        const ssize_t n = ::read(fd, p, size);
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+
+    return true;
+}
+
+inline void writeAll(const int fd, const void* data, size_t size) {
+    const auto* p = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t n = ::write(fd, p, size);
+        if (n <= 0) throw std::runtime_error("Failed to write to the socket");
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+// Returns false when the peer closed the connection before a complete frame
+inline bool readFrame(const int fd, std::string& out) {
+    uint32_t size;
+    if (!readAll(fd, &size, sizeof(size))) return false;
+
+    size = ntohl(size);
+    if (size > MAX_FRAME_SIZE) {
+        throw std::runtime_error("Frame too large");
+    }
+
+    out.resize(size);
+    return readAll(fd, out.data(), size);
+}
+
+inline void writeFrame(const int fd, const void* data, const size_t size) {
+    const uint32_t header = htonl(static_cast<uint32_t>(size));
+    writeAll(fd, &header, sizeof(header));
+    writeAll(fd, data, size);
+}
+
+inline void writeFrame(const int fd, const std::string& data) {
+    writeFrame(fd, data.data(), data.size());
+}
+}
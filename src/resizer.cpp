@@ -0,0 +1,118 @@
+#include "resizer.h"
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+
+Resizer::Resizer(CLPipeline& pipeline) : mPipeline(pipeline) {}
+
+ResizeFilter Resizer::getFilter(const char* name) {
+    if (!std::strcmp(name, "bilinear")) return ResizeFilter::BILINEAR;
+    if (!std::strcmp(name, "bicubic")) return ResizeFilter::BICUBIC;
+    if (!std::strcmp(name, "lanczos")) return ResizeFilter::LANCZOS3;
+
+    throw std::runtime_error("Unknown Filter: " + std::string(name));
+}
+
+void Resizer::setFilter(const ResizeFilter filter) {
+    mFilter = filter;
+    // Tables hold the weights of the previous filter
+    mRows.out = mColumns.out = 0;
+}
+
+void Resizer::run(cl_mem input, cl_mem output, const int width, const int height, const int outWidth,
+                  const int outHeight) {
+    prepare(mRows, width, outWidth);
+    prepare(mColumns, height, outHeight);
+
+    const size_t pixels = static_cast<size_t>(outWidth) * height;
+    if (pixels > mScratchCapacity) {
+        mScratch = mPipeline.createBuffer(pixels * sizeof(cl_float4), CL_MEM_READ_WRITE);
+        mScratchCapacity = pixels;
+    }
+
+    mPipeline.createProgram("resize");
+    mPipeline.createKernel("resize_rows");
+    mPipeline.setKernelArgs(input, mScratch, width, outWidth, height, mRows.starts, mRows.weights, mRows.taps);
+    mPipeline.execute(outWidth, height);
+    mPipeline.createKernel("resize_columns");
+    mPipeline.setKernelArgs(mScratch, output, height, outWidth, outHeight, mColumns.starts, mColumns.weights,
+                            mColumns.taps);
+    mPipeline.execute(outWidth, outHeight);
+}
+
+void Resizer::prepare(Table& table, const int in, const int out) const {
+    if (table.in == in && table.out == out) return;
+
+    Taps host = taps(mFilter, in, out);
+    table.starts = mPipeline.createBuffer(host.starts.size() * sizeof(cl_int), CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                          host.starts.data());
+    table.weights = mPipeline.createBuffer(host.weights.size() * sizeof(float),
+                                           CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, host.weights.data());
+    table.taps = host.taps;
+    table.in = in;
+    table.out = out;
+}
+
+Resizer::Taps Resizer::taps(const ResizeFilter filter, const int in, const int out) {
+    const double scale = static_cast<double>(out) / in;
+    // Downscaling widens the filter to cover all the source pixels of an output
+    const double stretch = scale < 1.0 ? 1.0 / scale : 1.0;
+    const double reach = support(filter) * stretch;
+
+    Taps result;
+    result.taps = static_cast<int>(std::ceil(reach)) * 2 + 1;
+    result.starts.resize(out);
+    result.weights.resize(static_cast<size_t>(out) * result.taps);
+    for (int i = 0; i < out; ++i) {
+        // Pixel centres sit at half-integer coordinates on both grids
+        const double center = (i + 0.5) / scale;
+        const int start = static_cast<int>(std::floor(center - reach));
+        result.starts[i] = start;
+
+        // Normalised, so flat areas keep their value whatever the filter's lobes add up to
+        float* row = result.weights.data() + static_cast<size_t>(i) * result.taps;
+        double sum = 0;
+        for (int k = 0; k < result.taps; ++k) {
+            sum += weight(filter, (start + k + 0.5 - center) / stretch);
+        }
+        for (int k = 0; k < result.taps; ++k) {
+            row[k] = static_cast<float>(weight(filter, (start + k + 0.5 - center) / stretch) / sum);
+        }
+    }
+    return result;
+}
+
+double Resizer::weight(const ResizeFilter filter, double x) {
+    x = std::abs(x);
+    switch (filter) {
+        case ResizeFilter::BILINEAR:
+            return x < 1.0 ? 1.0 - x : 0.0;
+        case ResizeFilter::BICUBIC: {
+            // Keys cubic with a = -0.5, which reproduces linear ramps exactly
+            constexpr double a = -0.5;
+            if (x < 1.0) return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+            if (x < 2.0) return ((a * x - 5.0 * a) * x + 8.0 * a) * x - 4.0 * a;
+            return 0.0;
+        }
+        case ResizeFilter::LANCZOS3: {
+            if (x == 0.0) return 1.0;
+            if (x >= 3.0) return 0.0;
+            const double px = std::numbers::pi * x;
+            return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+        }
+    }
+
+    return 0.0;
+}
+
+double Resizer::support(const ResizeFilter filter) {
+    switch (filter) {
+        case ResizeFilter::BILINEAR: return 1.0;
+        case ResizeFilter::BICUBIC: return 2.0;
+        case ResizeFilter::LANCZOS3: return 3.0;
+    }
+
+    return 1.0;
+}
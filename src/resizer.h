@@ -0,0 +1,65 @@
+#ifndef RESIZER_H
+#define RESIZER_H
+
+#include <cstddef>
+#include <vector>
+#include "clPipeline.h"
+
+enum class ResizeFilter {
+    BILINEAR, BICUBIC, LANCZOS3
+};
+
+// Resampling in two passes, rows then columns, each output pixel a weighted sum of
+// a fixed number of taps. Weights are computed on the host once per axis, size pair
+// and filter. When downscaling, the filter is stretched by the scale factor so it
+// averages every source pixel it covers instead of aliasing.
+class Resizer {
+public:
+    explicit Resizer(CLPipeline& pipeline);
+
+    static ResizeFilter getFilter(const char* name);
+
+    void setFilter(ResizeFilter filter);
+
+    // input holds width x height packed RGBA pixels, output outWidth x outHeight
+    void run(cl_mem input, cl_mem output, int width, int height, int outWidth, int outHeight);
+
+    // Taps of one axis: output i reads taps source pixels from starts[i] on, clamped
+    // to the edge, with weights[i * taps + k]
+    struct Taps {
+        std::vector<cl_int> starts;
+        std::vector<float> weights;
+        int taps{};
+    };
+
+    // Taps resampling in pixels to out with filter; the weights of every output sum to 1
+    static Taps taps(ResizeFilter filter, int in, int out);
+
+private:
+    // Device copy of the taps of one axis
+    struct Table {
+        CLMem starts;
+        CLMem weights;
+        int taps{};
+        int in{};
+        int out{};
+    };
+
+    void prepare(Table& table, int in, int out) const;
+
+    // Filter value at distance x, in source pixels of the unstretched filter
+    [[nodiscard]] static double weight(ResizeFilter filter, double x);
+
+    // Half-width of the filter
+    [[nodiscard]] static double support(ResizeFilter filter);
+
+    CLPipeline& mPipeline;
+    ResizeFilter mFilter{ResizeFilter::LANCZOS3};
+    Table mRows;
+    Table mColumns;
+    // float4 result of the row pass, outWidth x height
+    CLMem mScratch;
+    size_t mScratchCapacity{};
+};
+
+#endif //RESIZER_H
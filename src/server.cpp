@@ -0,0 +1,188 @@
+#include "server.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "protocol.hpp"
+
+static PixelBuffer pixels(const Image& image) {
+    return {image.raw(), image.width(), image.height(), 0, PixelFormat::RGBA8};
+}
+
+Server::Server(const char* socketPath, Engine& engine, const EncodeOptions& encodeOptions)
+    : mSocketPath(socketPath), mEngine(engine), mEncodeOptions(encodeOptions) {
+    sockaddr_un addr{};
+    if (mSocketPath.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + mSocketPath);
+    }
+
+    mListenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (mListenFd < 0) {
+        throw std::runtime_error("Failed to create the socket");
+    }
+
+    // Remove a stale socket left behind by a previous run
+    ::unlink(socketPath);
+
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+    if (::bind(mListenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(mListenFd, SOMAXCONN) < 0) {
+        ::close(mListenFd);
+        throw std::runtime_error("Failed to listen on " + mSocketPath + ": " + std::strerror(errno));
+    }
+
+    // A client hanging up mid-response must not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+}
+
+Server::~Server() {
+    ::close(mListenFd);
+    ::unlink(mSocketPath.c_str());
+}
+
+void Server::run() {
+    std::thread(&Server::dispatch, this).detach();
+
+    std::cout << "Listening on " << mSocketPath << std::endl;
+    while (true) {
+        const int fd = ::accept(mListenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            throw std::runtime_error(std::string("Failed to accept a connection: ") + std::strerror(errno));
+        }
+
+        std::thread(&Server::handleConnection, this, fd).detach();
+    }
+}
+
+void Server::handleConnection(const int fd) {
+    try {
+        while (handleRequest(fd)) {}
+    } catch (const std::exception& e) {
+        std::cerr << "Connection error: " << e.what() << std::endl;
+    }
+
+    ::close(fd);
+}
+
+bool Server::handleRequest(const int fd) {
+    std::string chain, format, kind, source, outfile;
+    if (!protocol::readFrame(fd, chain) || !protocol::readFrame(fd, format) || !protocol::readFrame(fd, kind) ||
+        !protocol::readFrame(fd, source) || !protocol::readFrame(fd, outfile)) {
+        return false;
+    }
+
+    try {
+        // Decoding and encoding happen on this connection's thread, concurrently with other clients
+        Image in{}, out{};
+        if (kind == "path") {
+            in.load(source.c_str());
+        } else if (kind == "data") {
+            in.load(reinterpret_cast<const uint8_t*>(source.data()), source.size());
+        } else {
+            throw std::runtime_error("Unknown source kind: " + kind);
+        }
+
+        const size_t space = format.find(' ');
+        EncodeOptions options = mEncodeOptions;
+        if (space != std::string::npos) {
+            options.quality = static_cast<int>(strtol(format.c_str() + space + 1, nullptr, 10));
+        }
+        format.resize(std::min(space, format.size()));
+        Job job{Engine::getEffects(chain.c_str()), &in, &out, {}};
+        const auto [width, height] = mEngine.outputSize(job.chain, in.width(), in.height());
+        out.create(width, height, 4, Image::getFormat(format.c_str()));
+
+        submit(job);
+
+        if (outfile.empty()) {
+            const std::vector<uint8_t> bytes = out.encode(options);
+            protocol::writeFrame(fd, "ok");
+            protocol::writeFrame(fd, bytes.data(), bytes.size());
+        } else {
+            out.write(outfile.c_str(), options);
+            protocol::writeFrame(fd, "ok");
+            protocol::writeFrame(fd, "");
+        }
+    } catch (const std::exception& e) {
+        protocol::writeFrame(fd, "error");
+        protocol::writeFrame(fd, e.what());
+    }
+
+    return true;
+}
+
+void Server::submit(Job& job) {
+    std::future<void> done = job.done.get_future();
+    {
+        std::lock_guard lock(mMutex);
+        mJobs.push_back(&job);
+    }
+    mCond.notify_one();
+
+    // Rethrows anything the dispatcher reported for this job
+    done.get();
+}
+
+void Server::dispatch() {
+    while (true) {
+        std::vector<Job*> batch;
+        {
+            std::unique_lock lock(mMutex);
+            mCond.wait(lock, [this] { return !mJobs.empty(); });
+
+            while (!mJobs.empty() && batch.size() < MAX_BATCH) {
+                batch.push_back(mJobs.front());
+                mJobs.pop_front();
+            }
+        }
+
+        // Group jobs sharing a chain so they run back to back on the same kernels
+        std::stable_sort(batch.begin(), batch.end(), [](const Job* a, const Job* b) { return a->chain < b->chain; });
+
+        for (auto first = batch.begin(); first != batch.end();) {
+            const auto last = std::find_if(first, batch.end(),
+                                           [&](const Job* job) { return job->chain != (*first)->chain; });
+            execute(std::span(first, last));
+            first = last;
+        }
+    }
+}
+
+void Server::execute(const std::span<Job*> jobs) {
+    // Small images of a batchable chain share a single launch per effect; the rest go one by one
+    std::vector<Job*> small;
+    std::vector<PixelBuffer> srcs, dsts;
+    for (Job* job : jobs) {
+        if (static_cast<size_t>(job->in->width()) * job->in->height() <= Engine::BATCH_MAX_PIXELS &&
+            mEngine.supportsBatch(job->chain)) {
+            small.push_back(job);
+            srcs.push_back(pixels(*job->in));
+            dsts.push_back(pixels(*job->out));
+            continue;
+        }
+
+        try {
+            mEngine.process(job->chain, pixels(*job->in), pixels(*job->out));
+            job->done.set_value();
+        } catch (...) {
+            job->done.set_exception(std::current_exception());
+        }
+    }
+
+    if (small.empty()) return;
+
+    try {
+        mEngine.processBatch(small.front()->chain, srcs, dsts);
+        for (Job* job : small) job->done.set_value();
+    } catch (...) {
+        for (Job* job : small) job->done.set_exception(std::current_exception());
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+#include "engine.h"
+#include "image.h"
+
+// Serves effect requests over a Unix domain socket (see protocol.hpp).
+// Connections are handled on their own threads, which decode and encode
+// concurrently; device work is funnelled to a single dispatcher that owns
+// the Engine and drains queued requests in batches; small images sharing an
+// effect chain are packed into a single launch per effect. Effect settings come
+// from the engine as configured by the caller; requests only pick the chain and format.
+class Server {
+public:
+    Server(const char* socketPath, Engine& engine, const EncodeOptions& encodeOptions);
+
+    ~Server();
+
+    [[noreturn]] void run();
+
+private:
+    struct Job {
+        std::vector<Effect> chain;
+        Image* in;
+        Image* out;
+        std::promise<void> done;
+    };
+
+    void handleConnection(int fd);
+
+    bool handleRequest(int fd);
+
+    void submit(Job& job);
+
+    void dispatch();
+
+    void execute(std::span<Job*> jobs);
+
+    std::string mSocketPath;
+    int mListenFd{-1};
+    // Only processes on the dispatcher thread
+    Engine& mEngine;
+    // Defaults for every response; a quality in the format frame overrides the jpg quality
+    EncodeOptions mEncodeOptions;
+
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    std::deque<Job*> mJobs;
+
+    static constexpr size_t MAX_BATCH = 32;
+};
+
+#endif //SERVER_H
@@ -0,0 +1,161 @@
+#include "writer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+AsyncWriter::AsyncWriter(const int threads, const SyncPolicy policy, const EncodeOptions& options)
+    : mPolicy(policy), mOptions(options), mMaxQueued(2 * static_cast<size_t>(std::max(threads, 1))) {
+    for (int i = 0; i < std::max(threads, 1); ++i) {
+        mWorkers.emplace_back(&AsyncWriter::work, this);
+    }
+}
+
+AsyncWriter::~AsyncWriter() {
+    {
+        std::lock_guard lock(mMutex);
+        mStopping = true;
+    }
+    mWork.notify_all();
+
+    for (auto& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+SyncPolicy AsyncWriter::getPolicy(const char* name) {
+    if (!std::strcmp(name, "none")) return SyncPolicy::NONE;
+    if (!std::strcmp(name, "file")) return SyncPolicy::PER_FILE;
+    if (!std::strcmp(name, "batch")) return SyncPolicy::BATCH;
+
+    throw std::runtime_error("Unknown fsync policy: " + std::string(name));
+}
+
+void AsyncWriter::submit(Image image, std::string path) {
+    {
+        std::unique_lock lock(mMutex);
+        mSpace.wait(lock, [this] { return mJobs.size() < mMaxQueued; });
+        mJobs.push_back({std::move(image), std::move(path)});
+    }
+    mWork.notify_one();
+}
+
+void AsyncWriter::flush() {
+    std::vector<std::string> written;
+    std::exception_ptr error;
+    {
+        std::unique_lock lock(mMutex);
+        mSpace.wait(lock, [this] { return mJobs.empty() && mInFlight == 0; });
+        written.swap(mWritten);
+        std::swap(error, mError);
+    }
+
+    // Every written file is synced even after a failure; the first error is reported
+    if (mPolicy == SyncPolicy::BATCH) {
+        for (const auto& path : written) {
+            try {
+                syncFile(path);
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void AsyncWriter::work() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock(mMutex);
+            mWork.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+
+            // Drain the queue before stopping so nothing submitted is lost
+            if (mJobs.empty()) return;
+
+            job = std::move(mJobs.front());
+            mJobs.pop_front();
+            ++mInFlight;
+        }
+        mSpace.notify_all();
+
+        std::exception_ptr error;
+        try {
+            writeFile(job.path, job.image.encode(mOptions), mPolicy == SyncPolicy::PER_FILE);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        // Release the pixels before reporting completion
+        job.image = Image{};
+
+        {
+            std::lock_guard lock(mMutex);
+            --mInFlight;
+            if (error && !mError) {
+                mError = error;
+            } else if (!error && mPolicy == SyncPolicy::BATCH) {
+                mWritten.push_back(std::move(job.path));
+            }
+        }
+        mSpace.notify_all();
+    }
+}
+
+void AsyncWriter::writeFile(const std::string& path, const std::vector<uint8_t>& bytes, const bool sync) {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+    }
+
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size() && std::fflush(file) == 0;
+    if (ok && sync) {
+#ifdef _WIN32
+        ok = _commit(_fileno(file)) == 0;
+#else
+        ok = fsync(fileno(file)) == 0;
+#endif
+    }
+    // Keep the first error; fclose can also report a failed write-back
+    const int error = ok ? 0 : errno;
+    if (std::fclose(file) != 0 && ok) {
+        throw std::runtime_error("Failed to close " + path + ": " + std::strerror(errno));
+    }
+
+    if (!ok) {
+        throw std::runtime_error("Failed to write " + path + ": " + std::strerror(error));
+    }
+}
+
+void AsyncWriter::syncFile(const std::string& path) {
+#ifdef _WIN32
+    std::FILE* file = std::fopen(path.c_str(), "ab");
+    if (file == nullptr) {
+        throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+    }
+    const bool ok = _commit(_fileno(file)) == 0;
+    const int error = errno;
+    std::fclose(file);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+    }
+    const bool ok = fsync(fd) == 0;
+    const int error = errno;
+    ::close(fd);
+#endif
+
+    if (!ok) {
+        throw std::runtime_error("Failed to sync " + path + ": " + std::strerror(error));
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "image.h"
+
+enum class SyncPolicy {
+    NONE,       // leave flushing to the OS
+    PER_FILE,   // fsync every file before it counts as written
+    BATCH       // fsync all written files once, in flush()
+};
+
+// Encodes and writes finished images on background threads so the caller can
+// move on to the next job. The queue is bounded: submit() blocks while it is
+// full, which caps the memory held by images waiting to be written.
+class AsyncWriter {
+public:
+    AsyncWriter(int threads, SyncPolicy policy, const EncodeOptions& options);
+
+    ~AsyncWriter();
+
+    AsyncWriter(const AsyncWriter&) = delete;
+
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    void submit(Image image, std::string path);
+
+    // Waits until everything submitted is written, applies the batch sync policy
+    // and rethrows the first write, close or sync error
+    void flush();
+
+    static SyncPolicy getPolicy(const char* name);
+
+private:
+    struct Job {
+        Image image;
+        std::string path;
+    };
+
+    void work();
+
+    static void writeFile(const std::string& path, const std::vector<uint8_t>& bytes, bool sync);
+
+    static void syncFile(const std::string& path);
+
+    SyncPolicy mPolicy;
+    EncodeOptions mOptions;
+    size_t mMaxQueued;
+
+    std::mutex mMutex;
+    std::condition_variable mWork;
+    std::condition_variable mSpace;
+    std::deque<Job> mJobs;
+    size_t mInFlight{};
+    bool mStopping{false};
+    std::exception_ptr mError;
+    std::vector<std::string> mWritten;
+
+    std::vector<std::thread> mWorkers;
+};
+
+#endif //WRITER_H
@@ -0,0 +1,83 @@
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "convolution.h"
+
+// Separability detection of Convolution: rank-1 matrices must split into a row and
+// a column whose product gives the matrix back, anything else must stay one pass.
+namespace {
+
+int failures = 0;
+
+void expect(const bool condition, const std::string& what) {
+    if (condition) return;
+
+    std::cerr << what << std::endl;
+    ++failures;
+}
+
+// Outer product column * row, row-major
+Convolution outer(const std::vector<float>& column, const std::vector<float>& row) {
+    std::vector<float> weights;
+    for (const float c : column) {
+        for (const float r : row) {
+            weights.push_back(c * r);
+        }
+    }
+    return {static_cast<int>(row.size()), static_cast<int>(column.size()), std::move(weights)};
+}
+
+void expectSeparable(const char* name, const Convolution& convolution) {
+    expect(convolution.separable(), std::format("{}: not found separable", name));
+    if (!convolution.separable()) return;
+
+    expect(static_cast<int>(convolution.row().size()) == convolution.width() &&
+           static_cast<int>(convolution.column().size()) == convolution.height(),
+           std::format("{}: factors have the wrong lengths", name));
+    for (int y = 0; y < convolution.height(); ++y) {
+        for (int x = 0; x < convolution.width(); ++x) {
+            const float weight = convolution.weights()[y * convolution.width() + x];
+            const float product = convolution.column()[y] * convolution.row()[x];
+            if (std::abs(product - weight) <= 1e-5f * (1.0f + std::abs(weight))) continue;
+
+            expect(false, std::format("{}: ({}, {}) factors to {} instead of {}", name, x, y, product, weight));
+            return;
+        }
+    }
+}
+}
+
+int main() {
+    try {
+        expectSeparable("binomial 5x5", outer({1, 4, 6, 4, 1}, {1, 4, 6, 4, 1}));
+        expectSeparable("sobel", Convolution::parse("-1,0,1;-2,0,2;-1,0,1"));
+        expectSeparable("box 3x7", outer({1, 1, 1, 1, 1, 1, 1}, {1, 1, 1}));
+        // Negative and zero entries, and a largest row that is not the first
+        expectSeparable("signed 4x3", outer({0.5f, -2, 0}, {3, 0, -1, 0.25f}));
+
+        for (const char* spec : {"sharpen", "emboss", "edge", "1,2;3,4", "1,0,0;0,1,0;0,0,1"}) {
+            expect(!Convolution::parse(spec).separable(), std::format("{}: found separable", spec));
+        }
+
+        // Rank 1 apart from one entry
+        Convolution nearly = outer({1, 2, 1}, {1, 2, 1});
+        std::vector<float> weights = nearly.weights();
+        weights[4] += 0.01f;
+        expect(!Convolution(3, 3, std::move(weights)).separable(), "perturbed binomial: found separable");
+
+        // Already one pass; nothing to split
+        expect(!Convolution::parse("1,2,3,2,1").separable(), "single row: found separable");
+        expect(!Convolution(3, 3, std::vector<float>(9, 0.0f)).separable(), "zero matrix: found separable");
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <numbers>
+#include <random>
+#include <string>
+#include <vector>
+#include "convolution.h"
+#include "fft.h"
+#include "fftConvolver.h"
+
+// The host FFTs against a direct DFT, and FftConvolver's host path against direct
+// convolution with clamped edges, as convolve.cl computes it.
+namespace {
+
+int failures = 0;
+
+void expect(const bool condition, const std::string& what) {
+    if (condition) return;
+
+    std::cerr << what << std::endl;
+    ++failures;
+}
+
+void checkTransform(const size_t n, std::mt19937& random) {
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    std::vector<std::complex<float>> data(n);
+    for (auto& x : data) {
+        x = {value(random), value(random)};
+    }
+
+    // Every other element, to cover the stride
+    std::vector<std::complex<float>> strided(2 * n);
+    for (size_t i = 0; i < n; ++i) {
+        strided[2 * i] = data[i];
+    }
+    fft::transform(strided.data(), n, 2, false);
+
+    double error = 0;
+    for (size_t k = 0; k < n; ++k) {
+        std::complex<double> sum;
+        for (size_t i = 0; i < n; ++i) {
+            sum += std::complex<double>(data[i]) * std::polar(1.0, -2 * std::numbers::pi * i * k / n);
+        }
+        error = std::max(error, std::abs(sum - std::complex<double>(strided[2 * k])));
+    }
+    expect(error < 1e-4 * n, std::format("transform of {}: off the DFT by {}", n, error));
+
+    // The inverse is unscaled
+    fft::transform(strided.data(), n, 2, true);
+    error = 0;
+    for (size_t i = 0; i < n; ++i) {
+        error = std::max(error, static_cast<double>(std::abs(strided[2 * i] / static_cast<float>(n) - data[i])));
+    }
+    expect(error < 1e-5 * n, std::format("round trip of {}: off by {}", n, error));
+}
+
+void checkConvolve(const int width, const int height, const Convolution& convolution, std::mt19937& random) {
+    std::vector<uint8_t> input(static_cast<size_t>(width) * height * 4);
+    for (uint8_t& value : input) {
+        value = static_cast<uint8_t>(random());
+    }
+    std::vector<uint8_t> output(input.size());
+    FftConvolver::convolve(input.data(), output.data(), width, height, convolution);
+
+    const int anchorX = convolution.width() / 2;
+    const int anchorY = convolution.height() / 2;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            for (int c = 0; c < 4; ++c) {
+                double sum = 0;
+                for (int ky = 0; ky < convolution.height(); ++ky) {
+                    const int iy = std::clamp(y + ky - anchorY, 0, height - 1);
+                    for (int kx = 0; kx < convolution.width(); ++kx) {
+                        const int ix = std::clamp(x + kx - anchorX, 0, width - 1);
+                        sum += convolution.weights()[ky * convolution.width() + kx] *
+                               input[(static_cast<size_t>(iy) * width + ix) * 4 + c];
+                    }
+                }
+                const int expected = c == 3 ? 255 : static_cast<int>(std::clamp(std::nearbyint(sum), 0.0, 255.0));
+                const int actual = output[(static_cast<size_t>(y) * width + x) * 4 + c];
+                if (std::abs(actual - expected) <= 1) continue;
+
+                expect(false, std::format("{}x{} matrix on {}x{}: ({}, {}) channel {} is {}, expected {}",
+                                          convolution.width(), convolution.height(), width, height, x, y, c, actual,
+                                          expected));
+                return;
+            }
+        }
+    }
+}
+
+Convolution randomMatrix(const int width, const int height, std::mt19937& random) {
+    // Positive and negative weights summing to about one, so outputs span the range
+    std::uniform_real_distribution<float> weight(-1.0f, 3.0f);
+    std::vector<float> weights(static_cast<size_t>(width) * height);
+    for (float& w : weights) {
+        w = weight(random) / static_cast<float>(weights.size());
+    }
+    return {width, height, std::move(weights)};
+}
+}
+
+int main() {
+    std::mt19937 random(1);
+    try {
+        for (const size_t n : {1, 2, 8, 64, 1024}) {
+            checkTransform(n, random);
+        }
+
+        // Odd and even sides, non-square matrices, and matrices larger than the image
+        checkConvolve(37, 23, randomMatrix(5, 5, random), random);
+        checkConvolve(64, 48, randomMatrix(9, 3, random), random);
+        checkConvolve(50, 31, randomMatrix(4, 6, random), random);
+        checkConvolve(12, 9, randomMatrix(21, 15, random), random);
+        checkConvolve(40, 40, Convolution::parse("sharpen"), random);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "image.h"
+#include "pngEncoder.h"
+
+// PNGs encoded in several bands must form one valid stream: each one is decoded
+// again through stb and compared with the pixels it was encoded from.
+namespace {
+
+// Number of channels that came back different, reporting the first
+int roundTrip(const int width, const int height, const int channels, const int level, const int threads,
+              std::mt19937& random) {
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * channels);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        // Noise on smooth gradients, so every PNG filter type gets picked somewhere
+        pixels[i] = static_cast<uint8_t>(i / channels % width + i / channels / width + random() % 8);
+    }
+
+    const std::vector<uint8_t> png = PngEncoder::encode(pixels.data(), width, height, channels, level, threads);
+
+    Image decoded{};
+    decoded.load(png.data(), png.size());
+    if (decoded.width() != width || decoded.height() != height) {
+        std::cerr << std::format("{}x{}, {} channels, {} threads: decoded as {}x{}\n", width, height, channels,
+                                 threads, decoded.width(), decoded.height());
+        return 1;
+    }
+
+    // Images always decode to RGBA
+    int failures = 0;
+    for (size_t p = 0; p < static_cast<size_t>(width) * height; ++p) {
+        for (int c = 0; c < 4; ++c) {
+            const uint8_t expected = c < channels ? pixels[p * channels + c] : 255;
+            const uint8_t actual = decoded.raw()[p * 4 + c];
+            if (actual == expected) continue;
+
+            if (failures++ == 0) {
+                std::cerr << std::format("{}x{}, {} channels, {} threads: pixel {} channel {} is {}, expected {}\n",
+                                         width, height, channels, threads, p, c, actual, expected);
+            }
+        }
+    }
+    return failures;
+}
+}
+
+int main() {
+    std::mt19937 random(1);
+    int failures = 0;
+    try {
+        for (const int channels : {3, 4}) {
+            for (const int threads : {1, 3, 8}) {
+                // Heights that do and do not divide into the bands evenly
+                failures += roundTrip(301, 517, channels, 6, threads, random);
+                failures += roundTrip(64, 192, channels, 1, threads, random);
+            }
+        }
+        // Too small for more than one band whatever the thread count
+        failures += roundTrip(7, 5, 4, 9, 8, random);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
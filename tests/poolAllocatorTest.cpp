@@ -0,0 +1,79 @@
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <string>
+#include "poolAllocator.h"
+
+// Size classes and reuse of PoolAllocator, through its statistics: sizes within a
+// class share blocks, classes stay within 25% of the request, and blocks beyond
+// the cache limit go back to the OS.
+namespace {
+
+int failures = 0;
+
+void expect(const bool condition, const std::string& what) {
+    if (condition) return;
+
+    std::cerr << what << std::endl;
+    ++failures;
+}
+
+// Class size of a request, as the growth of inUse
+size_t classOf(PoolAllocator& pool, const size_t size) {
+    const size_t before = pool.stats().inUse;
+    uint8_t* block = pool.allocate(size);
+    const size_t bytes = pool.stats().inUse - before;
+    pool.deallocate(block, size);
+    return bytes;
+}
+}
+
+int main() {
+    {
+        PoolAllocator pool;
+        // The smallest class is one page
+        const size_t page = classOf(pool, 1);
+        expect(page >= 4096 && (page & (page - 1)) == 0, std::format("Page size {}", page));
+
+        for (const size_t size : {size_t{1}, page, page + 1, 5 * page + 3, 1000 * page + 17, size_t{12345678}}) {
+            const size_t bytes = classOf(pool, size);
+            expect(bytes >= size && bytes % page == 0, std::format("{} bytes got class {}", size, bytes));
+            expect(bytes <= page || bytes - size < size / 4 + page,
+                   std::format("{} bytes got class {}, more than 25% over", size, bytes));
+        }
+
+        // Sizes in one class share a block, which comes back page-aligned and reused
+        uint8_t* first = pool.allocate(1000 * page);
+        expect(reinterpret_cast<uintptr_t>(first) % page == 0, "Block is not page-aligned");
+        pool.deallocate(first, 1000 * page);
+        const size_t hits = pool.stats().hits;
+        uint8_t* second = pool.allocate(1000 * page - 100);
+        expect(second == first, "Same-class allocation did not reuse the cached block");
+        expect(pool.stats().hits == hits + 1, "Reuse was not counted as a hit");
+        pool.deallocate(second, 1000 * page - 100);
+
+        // A different class maps new memory
+        const size_t misses = pool.stats().misses;
+        uint8_t* other = pool.allocate(2000 * page);
+        expect(pool.stats().misses == misses + 1, "New class did not map new memory");
+        pool.deallocate(other, 2000 * page);
+        expect(pool.stats().inUse == 0, "Bytes still in use after every block was returned");
+    }
+
+    {
+        // A cache of one byte keeps nothing, so returned blocks are unmapped
+        PoolAllocator pool(1);
+        uint8_t* block = pool.allocate(1 << 20);
+        pool.deallocate(block, 1 << 20);
+        const PoolStats stats = pool.stats();
+        expect(stats.cached == 0 && stats.reserved == 0, "Block over the cache limit was kept");
+        expect(stats.peakReserved >= 1 << 20, std::format("Peak is {} bytes", stats.peakReserved));
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
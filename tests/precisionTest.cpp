@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "engine.h"
+
+// Blur and sepia at fp16 and fixed point against fp32 on random pixels: every channel
+// must stay within one step of fp32, and white must stay white in every mode. fp32
+// itself is pinned to round to nearest on a few known values. Run from the repository
+// root, where the kernels are. Without an OpenCL GPU it exits with SKIPPED, which
+// CTest reports as a skipped test.
+namespace {
+
+constexpr int WIDTH = 257;
+constexpr int HEIGHT = 131;
+constexpr int SKIPPED = 77;
+
+std::vector<uint8_t> run(Engine& engine, const Effect effect, std::vector<uint8_t>& input) {
+    std::vector<uint8_t> output(input.size());
+    engine.process(effect, PixelBuffer{input.data(), WIDTH, HEIGHT, 0, PixelFormat::RGBA8},
+                   PixelBuffer{output.data(), WIDTH, HEIGHT, 0, PixelFormat::RGBA8});
+    return output;
+}
+
+// Number of channels more than one step away from expected, reporting the first
+int compare(const char* name, const std::vector<uint8_t>& expected, const std::vector<uint8_t>& actual) {
+    int failures = 0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        if (std::abs(expected[i] - actual[i]) <= 1) continue;
+
+        if (failures++ == 0) {
+            std::cerr << std::format("{}: pixel {} channel {} is {}, fp32 gives {}\n", name, i / 4, i % 4,
+                                     actual[i], expected[i]);
+        }
+    }
+    return failures;
+}
+
+// White in, white out: the weights must not lose the last step to truncation
+int checkWhite(const char* name, Engine& engine, const Effect effect) {
+    std::vector<uint8_t> white(static_cast<size_t>(WIDTH) * HEIGHT * 4, 255);
+    const std::vector<uint8_t> output = run(engine, effect, white);
+    for (size_t i = 0; i < output.size(); ++i) {
+        if (output[i] != 255) {
+            std::cerr << std::format("{}: white pixel {} channel {} is {}\n", name, i / 4, i % 4, output[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// fp32 used to truncate and now rounds to nearest; these values each moved up a step
+// with that change and pin it down
+int checkFp32Rounding(Engine& engine) {
+    const size_t size = static_cast<size_t>(WIDTH) * HEIGHT * 4;
+    int failures = 0;
+
+    // Flat grays keep their level through the blur, whose weights sum to just under one
+    for (const int level : {1, 37, 100, 128, 200, 254}) {
+        std::vector<uint8_t> flat(size, static_cast<uint8_t>(level));
+        const std::vector<uint8_t> output = run(engine, Effect::GAUSSIAN_BLUR, flat);
+        for (size_t i = 0; i < output.size(); ++i) {
+            if (output[i] == level) continue;
+
+            std::cerr << std::format("gb fp32: flat {} gives {} at pixel {}\n", level, output[i], i / 4);
+            ++failures;
+            break;
+        }
+    }
+
+    // Sepia of pixels whose every channel comes out more than half a step above a whole number
+    struct Pin {
+        uint8_t in[3];
+        uint8_t out[3];
+    };
+    constexpr Pin pins[] = {{{167, 53, 108}, {127, 113, 88}}, {{184, 70, 193}, {163, 145, 113}},
+                            {{153, 193, 53}, {219, 195, 152}}, {{113, 137, 122}, {173, 154, 120}}};
+    std::vector<uint8_t> pixels(size);
+    for (size_t i = 0; i < size / 4; ++i) {
+        const Pin& pin = pins[i % std::size(pins)];
+        std::copy_n(pin.in, 3, &pixels[i * 4]);
+        pixels[i * 4 + 3] = 255;
+    }
+    const std::vector<uint8_t> output = run(engine, Effect::SEPIA, pixels);
+    for (size_t i = 0; i < size / 4; ++i) {
+        const Pin& pin = pins[i % std::size(pins)];
+        if (std::equal(pin.out, pin.out + 3, &output[i * 4])) continue;
+
+        std::cerr << std::format("sep fp32: ({}, {}, {}) gives ({}, {}, {}), expected ({}, {}, {})\n", pin.in[0],
+                                 pin.in[1], pin.in[2], output[i * 4], output[i * 4 + 1], output[i * 4 + 2],
+                                 pin.out[0], pin.out[1], pin.out[2]);
+        ++failures;
+        break;
+    }
+    return failures;
+}
+}
+
+int main() {
+    std::unique_ptr<Engine> engine;
+    try {
+        engine = std::make_unique<Engine>();
+    } catch (const std::exception& e) {
+        std::cerr << "Skipped: " << e.what() << std::endl;
+        return SKIPPED;
+    }
+
+    std::mt19937 random(1);
+    std::vector<uint8_t> input(static_cast<size_t>(WIDTH) * HEIGHT * 4);
+    for (uint8_t& value : input) {
+        value = static_cast<uint8_t>(random());
+    }
+
+    struct Mode {
+        Precision precision;
+        const char* name;
+    };
+    constexpr Mode modes[] = {{Precision::FP32, "fp32"}, {Precision::FP16, "fp16"}, {Precision::FIXED, "fixed"}};
+    constexpr Effect effects[] = {Effect::GAUSSIAN_BLUR, Effect::SEPIA};
+
+    int failures = 0;
+    try {
+        failures += checkFp32Rounding(*engine);
+
+        std::vector<uint8_t> expected[std::size(effects)];
+        for (const Mode& mode : modes) {
+            try {
+                engine->setPrecision(mode.precision);
+            } catch (const std::runtime_error& e) {
+                // fp16 needs cl_khr_fp16; the other modes still run
+                std::cerr << std::format("{} skipped: {}\n", mode.name, e.what());
+                continue;
+            }
+
+            for (size_t i = 0; i < std::size(effects); ++i) {
+                const std::string name = std::format("{} {}", i == 0 ? "gb" : "sep", mode.name);
+                std::vector<uint8_t> output = run(*engine, effects[i], input);
+                if (mode.precision == Precision::FP32) {
+                    expected[i] = std::move(output);
+                } else {
+                    failures += compare(name.c_str(), expected[i], output);
+                }
+                failures += checkWhite(name.c_str(), *engine, effects[i]);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <string>
+#include <utility>
+#include "resizer.h"
+
+// Resizer's weight tables: every output's weights sum to one, so flat areas keep
+// their value, when upscaling and when the filter is stretched for downscaling, and
+// the taps of every output cover the source position it maps back to.
+namespace {
+
+int failures = 0;
+
+void expect(const bool condition, const std::string& what) {
+    if (condition) return;
+
+    std::cerr << what << std::endl;
+    ++failures;
+}
+
+void checkTaps(const char* name, const ResizeFilter filter, const int in, const int out) {
+    const Resizer::Taps taps = Resizer::taps(filter, in, out);
+    const std::string label = std::format("{} {} -> {}", name, in, out);
+    if (taps.taps <= 0 || taps.starts.size() != static_cast<size_t>(out) ||
+        taps.weights.size() != static_cast<size_t>(out) * taps.taps) {
+        expect(false, label + ": table has the wrong shape");
+        return;
+    }
+
+    for (int i = 0; i < out; ++i) {
+        double sum = 0, first = 0;
+        for (int k = 0; k < taps.taps; ++k) {
+            const double weight = taps.weights[static_cast<size_t>(i) * taps.taps + k];
+            sum += weight;
+            first += weight * (taps.starts[i] + k + 0.5);
+        }
+        if (std::abs(sum - 1.0) > 1e-5) {
+            expect(false, std::format("{}: weights of output {} sum to {}", label, i, sum));
+            return;
+        }
+
+        // The taps reach past the output centre mapped back on both sides
+        const double center = (i + 0.5) * in / out;
+        if (taps.starts[i] + 0.5 > center || taps.starts[i] + taps.taps - 0.5 < center) {
+            expect(false, std::format("{}: taps of output {} miss its centre {}", label, i, center));
+            return;
+        }
+
+        // Upscaling, bilinear and bicubic reproduce linear ramps, so the weighted source
+        // position is the centre itself
+        if (filter != ResizeFilter::LANCZOS3 && out >= in && std::abs(first - center) > 1e-4) {
+            expect(false, std::format("{}: output {} centred on {} instead of {}", label, i, first, center));
+            return;
+        }
+    }
+}
+}
+
+int main() {
+    constexpr std::pair<ResizeFilter, const char*> filters[] = {
+        {ResizeFilter::BILINEAR, "bilinear"}, {ResizeFilter::BICUBIC, "bicubic"}, {ResizeFilter::LANCZOS3, "lanczos"}};
+    constexpr std::pair<int, int> sizes[] = {
+        {100, 100}, {100, 333}, {7, 64}, {1, 5}, {512, 256}, {1000, 37}, {640, 479}, {33, 1}};
+
+    for (const auto& [filter, name] : filters) {
+        for (const auto& [in, out] : sizes) {
+            checkTaps(name, filter, in, out);
+        }
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}